@@ -0,0 +1,119 @@
+#ifdef INCLUDE_AUTOBAUD
+/* Automatic baud rate detection.
+ *
+ * The softuart's edge receiver already timestamps every RX edge at F_CPU/64
+ * (4us per count); while listening it also hands us the pulse widths. The
+ * shortest pulse is about one bit; every other pulse should be close to a
+ * whole number of half bits, which refines the estimate. Long space runs
+ * can only happen with 8 bit frames, half bit pulses only with the 1.5 stop
+ * bits of 5 level machines. */
+
+#include "autobaud.h"
+#include "conf.h"
+#include "main.h"
+#include "out.h"
+#include "softuart.h"
+#include "tick.h"
+#ifdef INCLUDE_HWUART
+#include "hwuart.h"
+#endif
+#include <avr/pgmspace.h>
+
+extern uint16_t confflags; // from main.c
+
+#define AB_TICKS_PER_SEC (F_CPU / 64)
+#define AB_MAX_PULSES 64
+#define AB_MIN_PULSES 16
+#define AB_GLITCH (AB_TICKS_PER_SEC / 1000) // ignore pulses under 1ms
+#define AB_IDLE (AB_TICKS_PER_SEC / 2)      // longer than this is idle line
+
+#define AB_MARK SOFTUART_PULSE_MARK
+static uint32_t pulses[AB_MAX_PULSES];
+static uint8_t npulses;
+
+// keep the pulses worth looking at
+static void autobaud_collect(void) {
+  uint32_t p, w;
+
+  while ((npulses < AB_MAX_PULSES) && softuart_pulse_get(&p)) {
+    w = p & ~AB_MARK;
+    if ((w >= AB_GLITCH) && (w <= AB_IDLE))
+      pulses[npulses++] = p;
+  }
+}
+
+// Listen to the loop for up to seconds and set baud (and 5/8 bit framing,
+// if it can tell) from what comes in.
+void autobaud(uint8_t seconds) {
+  uint32_t start, w, shortest = 0, sum = 0;
+  uint16_t halves = 0, divisor, baud, i;
+  uint8_t n, h, long_space = 0, half_bits = 0;
+
+#ifdef INCLUDE_HWUART
+  if (hwuart_on) {
+    out_str_P(PSTR("Autobaud needs the soft UART.\r\n"));
+    return;
+  }
+#endif
+  out_msg(PSTR("Listening for "), seconds,
+          PSTR(" s, send some text from the machine...\r\n"));
+  npulses = 0;
+  softuart_pulses(1);
+  start = millis();
+  while ((npulses < AB_MAX_PULSES) &&
+         (millis() - start < (uint32_t)seconds * 1000)) {
+    autobaud_collect();
+    usbserial_tasks();
+  }
+  softuart_pulses(0);
+  softuart_flush_input_buffer();
+
+  if (npulses < AB_MIN_PULSES) {
+    out_msg(PSTR("Only "), npulses, PSTR(" pulses seen, baud unchanged.\r\n"));
+    return;
+  }
+
+  for (n = 0; n < npulses; n++) {
+    w = pulses[n] & ~AB_MARK;
+    if ((shortest == 0) || (w < shortest))
+      shortest = w;
+  }
+  // count every pulse in half bits of the shortest one, then average
+  for (n = 0; n < npulses; n++) {
+    w = pulses[n] & ~AB_MARK;
+    if (w > 12 * shortest) // too long to be sure of, skip it
+      continue;
+    h = (2 * w + shortest / 2) / shortest; // so at most 24, fits
+    sum += w;
+    halves += h;
+    if ((h & 1) && (pulses[n] & AB_MARK))
+      half_bits = 1;
+    if ((h > 13) && !(pulses[n] & AB_MARK))
+      long_space = 1; // start bit + 6 or more zero data bits
+  }
+  // one bit is sum / (halves / 2) counts; the softuart ticks at 3x that
+  divisor = (2 * sum + 3 * halves / 2) / (3 * halves);
+
+  // snap to a tested speed if we're within 4%
+  for (i = 0; i < NSPEEDS; i++) {
+    if ((divisor > speeds[i][1] - speeds[i][1] / 25) &&
+        (divisor < speeds[i][1] + speeds[i][1] / 25))
+      divisor = speeds[i][1];
+  }
+  set_softuart_divisor(divisor);
+  baud = divisor_to_baud(divisor);
+  out_msg(PSTR(""), npulses, PSTR(" pulses, divisor "));
+  out_msg(PSTR(""), divisor, PSTR(", baud "));
+  out_msg(PSTR(""), baud, PSTR(".\r\n"));
+
+  if (long_space && !half_bits) {
+    confflags |= CONF_8BIT;
+    confflags &= ~CONF_TRANSLATE;
+    out_str_P(PSTR("Looks like 8 bit frames, 8bit mode on.\r\n"));
+  } else if (half_bits && !long_space) {
+    confflags &= ~CONF_8BIT;
+    out_str_P(PSTR("Looks like 5 bit frames, 8bit mode off.\r\n"));
+  } else
+    out_str_P(PSTR("Couldn't tell 5 from 8 bit framing, left as is.\r\n"));
+}
+#endif
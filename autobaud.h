@@ -0,0 +1,2 @@
+// Measure the loop baud rate and framing from incoming traffic.
+void autobaud(uint8_t seconds);
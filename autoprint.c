@@ -1,12 +1,14 @@
 #ifdef INCLUDE_AUTOPRINT
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 #include <avr/eeprom.h>
 #include <avr/pgmspace.h>
 #include "baudot.h"
 #include "conf.h"
 #include "main.h"
+#include "out.h"
+#include "shift.h"
+#include "softuart.h"
 #include "usb_serial_getstr.h"
 
 // these are so do_autoprint() can keep processing usb events while
@@ -14,6 +16,9 @@
 #include "lufa_serial.h"
 extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface;
 
+// message chars stop short of this, leaving room for a CR and the 0xFF
+#define AUTOMSG_END (EEP_AUTOMSG_START + EEP_AUTOMSG_SIZE - 3)
+
 void do_autoprint(void)
 {
   char c;
@@ -21,10 +26,9 @@ void do_autoprint(void)
   softuart_turn_rx_off();
   tty_putchar('\r');
   tty_putchar('\n');
-  tty_putchar(64); // try to force known ltrs state
-  tty_putchar_raw(31); // set ltrs
-  for(i=0; i<512; i++) {
-    c = eeprom_read_byte(i+0x200);
+  shift_forget(); // whoever was on the loop may have left it in FIGS
+  for(i=0; i<EEP_AUTOMSG_SIZE; i++) {
+    c = eeprom_read_byte((const uint8_t *)(i+EEP_AUTOMSG_START));
     if (c == 0xff) break;
     tty_putchar(c);
     if (c == '\r')
@@ -40,28 +44,34 @@ void do_autoprint(void)
 void create_automsg(void)
 {
   uint8_t n;
-  uint16_t addr = 512;
+  uint16_t addr = EEP_AUTOMSG_START;
   static char linebuf[80];
   uint16_t i;
 
-  printf_P(PSTR("enter up to 512 bytes. EOF at beginning of line to finish.\r\n"));
+  // the spool's overflow is the end of this space, see spool.c
+  out_msg(PSTR("enter up to "), AUTOMSG_END - EEP_AUTOMSG_START,
+          PSTR(" bytes; up to "));
+  out_dec(EEP_SPOOL_START - EEP_AUTOMSG_START - 1);
+  out_str_P(PSTR(" leaves the spool its eeprom overflow.\r\n"
+                 "EOF at beginning of line to finish.\r\n"));
   while(1) {
-    printf("> ");
+    out_str_P(PSTR("> "));
     n = usb_serial_getstr(linebuf, 79);
-    printf("\r\n");
+    out_crlf();
     if (strncmp(linebuf, "EOF", 3) == 0)
       break;
 
     for(i=0; i<n; i++) {
-      eeprom_write_byte(addr, linebuf[i]);
+      eeprom_write_byte((uint8_t *)addr, linebuf[i]);
       addr++;
-      if (addr >=1021) break;
+      if (addr >= AUTOMSG_END) break;
     }
-    eeprom_write_byte(addr, '\r');
+    eeprom_write_byte((uint8_t *)addr, '\r');
     addr++;
+    if (addr >= AUTOMSG_END) break; // full
 
   }    
-  eeprom_write_byte(addr, 0xff);
-  printf_P(PSTR("end of message.\r\n"));
+  eeprom_write_byte((uint8_t *)addr, 0xff);
+  out_str_P(PSTR("end of message.\r\n"));
 }
 #endif
@@ -3,35 +3,48 @@
 
 #include "baudot.h"
 #include "conf.h"
-#include <avr/eeprom.h>
+#include "profile.h"
+#include "shift.h"
+#include "softuart.h"
+#include "stats.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern uint8_t confflags;     // from main.c
-extern uint8_t tableselector; // from main.c
+extern uint16_t confflags; // from main.c
 
 // global state variables for baudot shift state
-// these get used in a bunch of places
+// these get used in a bunch of places. Nobody knows what the machine was
+// left in at power up, see shift.c.
 uint8_t baudot_shift_rcv = LTRS;
-uint8_t baudot_shift_send = LTRS;
+uint8_t baudot_shift_send = SHIFT_UNKNOWN;
 
-// take an ASCII char, send Baudot to teletype
+// take an ASCII char, send Baudot to teletype. Returns 1 if it went out,
+// 0 if there's no Baudot for it.
 int tty_putchar(char c) {
   char b;
-  b = ascii_to_baudot(toupper(c));
+  b = ascii_to_baudot(c); // wider tables may have lower case
   if (b == 0)
+    b = ascii_to_baudot(toupper(c));
+  if (b == 0) {
+    if (c != 0)
+      stats.dropped++;
     return (0);
+  }
 
   // if ascii_to_baudot tells us we need to shift
   // the teletype's character set, do that first
-  if (b & (1 << 5)) {
-    softuart_putchar(baudot_shift_send);
-    b &= ~(1 << 5); // clear the "need shift" bit
+  if (b & BAUDOT_NEEDSHIFT) {
+    softuart_putchar(profile_code(baudot_shift_send));
+    shift_sent(profile_code(baudot_shift_send));
+    stats.shifts++;
+    b &= ~BAUDOT_NEEDSHIFT;
   }
   // now send the actual Baudot character.
   softuart_putchar(b);
-  return 0;
+  shift_sent(b);
+  return 1;
 }
 
 int tty_putchar_raw(char c) {
@@ -54,65 +67,82 @@ char figs[32] = { 0, '3', 0x0A, '-', ' ', 7, '8', '7',
 */
 
 // this is easy, because ascii >> baudot
-// Just keep track of LTRS/FIGS shift
+// Just keep track of LTRS/FIGS shift. The shift codes, and how many codes
+// there are, come from the table (see profile.c).
 char baudot_to_ascii(char b) {
   char asc = 0;
-  if (b == 0x1B) { // FIGS shift
-    baudot_shift_rcv = FIGS;
-    return (0);
-  }
-  if (b == 0x1F) { // LTRS shift
-    baudot_shift_rcv = LTRS;
+  uint8_t n = profile_codes();
+  uint8_t shift = profile_shift(b);
+  uint8_t code;
+
+  if (shift) {
+    baudot_shift_rcv = shift;
     return (0);
   }
+  code = b & (n - 1);
 
-  if ((confflags & CONF_UNSHIFT_ON_SPACE) && (b == 0x04)) // space
+  if ((confflags & CONF_UNSHIFT_ON_SPACE) && (profile_char(code) == ' '))
     baudot_shift_rcv = LTRS;
 
-  if (baudot_shift_rcv == LTRS)
-    asc = eeprom_read_byte(EEP_TABLES_START + (EEP_TABLE_SIZE * tableselector) +
-                           b);
+  if ((baudot_shift_rcv == LTRS) || !profile_code(FIGS))
+    asc = profile_ram[profile_cur][code];
   else if (baudot_shift_rcv == FIGS)
-    asc = eeprom_read_byte(EEP_TABLES_START + (EEP_TABLE_SIZE * tableselector) +
-                           FIGS_OFFSET + b);
+    asc = profile_ram[profile_cur][n + code];
 
   return (asc);
 }
 
 // harder, because baudot << ASCII. we track the
-// LTRS/FIGS shift, and set the 6th bit in the output
+// LTRS/FIGS shift, and set BAUDOT_NEEDSHIFT in the output
 // if the user is going to need to send a shift code
-// prior to sending the actual 5 bit baudot character.
-
+// prior to sending the actual baudot character.
+// Chars that are the same code in both cases never need one, and
+// tables without shifts never do.
 char ascii_to_baudot(char c) {
   uint8_t i;
-  uint8_t needcase = 0;
-  char b = 0;
+  uint8_t needcase;
+  uint8_t n = profile_codes();
+  uint8_t shifted = profile_code(FIGS) != 0;
+  char l = 0, f = 0, b;
+  const char *table = profile_ram[profile_cur];
 
+  if (c == 0)
+    return (0);
   // search for the ascii char in both the letters and figs tables
-  for (i = 0; i < 32; i++) {
-    if (eeprom_read_byte(EEP_TABLES_START + (EEP_TABLE_SIZE * tableselector) +
-                         i) == c) {
-      needcase = LTRS; // we found it in the LTRS table
-      b = i;
-    } else if (eeprom_read_byte(EEP_TABLES_START +
-                                (EEP_TABLE_SIZE * tableselector) + FIGS_OFFSET +
-                                i) == c) {
-      needcase = FIGS; // we found it in the FIGS table
-      b = i;
-    }
+  for (i = 1; i < n; i++) {
+    if (!l && (table[i] == c))
+      l = i;
+    if (shifted && !f && (table[n + i] == c))
+      f = i;
   }
-  // if called with a character that doesn't exist in Baudot,
-  // or a null char, return a blank.
-  if (b == 0)
+  if (!shifted)
+    return (l);
+
+  if (l && (l == f)) { // space, CR, LF: fine in either case
+    // the machine unshifts on space by itself
+    if ((c == ' ') && (confflags & CONF_UNSHIFT_ON_SPACE))
+      baudot_shift_send = LTRS;
+    return (l);
+  }
+  // if it's in both under different codes, take the one that needs no shift
+  if (l && (!f || (baudot_shift_send != FIGS))) {
+    b = l;
+    needcase = LTRS;
+  } else if (f) {
+    b = f;
+    needcase = FIGS;
+  } else {
+    // if called with a character that doesn't exist in Baudot,
+    // return a blank.
     return (0);
+  }
 
   if (needcase == baudot_shift_send) { // we're already in the correct shift
     return (b);
   } else {
     // signal the caller that it needs to transmit a shift character
-    // before the baudot character
-    b |= (1 << 5);
+    // before the baudot character. SHIFT_UNKNOWN always gets one.
+    b |= BAUDOT_NEEDSHIFT;
     baudot_shift_send = needcase;
     return (b);
   }
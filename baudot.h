@@ -12,3 +12,6 @@ extern volatile int8_t flag_tx_busy;
 
 #define LTRS 0x1F // Baudot Letters Shift
 #define FIGS 0x1B // Baudot Figures Shift
+
+// from ascii_to_baudot(): send the shift in baudot_shift_send first
+#define BAUDOT_NEEDSHIFT 0x80
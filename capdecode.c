@@ -0,0 +1,293 @@
+/* Host side decoder for "rxmode capture" output. Reads the binary records
+ * from a file (or stdin) and prints a timeline of what came in off the loop,
+ * one line per frame, followed by a short summary.
+ *
+ *   cat /dev/ttyACM0 > cap.bin     (after "+++ rxmode capture")
+ *   gcc -o capdecode capdecode.c -lm && ./capdecode cap.bin
+ *
+ * With -l it decodes "rxmode logic" output instead: raw RX pin samples at
+ * the rate the adapter printed when the mode was entered. It lists the mark
+ * and space runs, estimates the baud rate from them, and with -v also
+ * writes a VCD file for a waveform viewer such as GTKWave.
+ *
+ *   ./capdecode -l 150 -v loop.vcd la.bin
+ *
+ * With -r it reads "rxmode record" output, whole lines with the time each
+ * started, and prints them one per line. A line sent in pieces (too long,
+ * or the sender paused) is put back together, timed from its first piece.
+ *
+ *   ./capdecode -r lines.bin
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rxout.h"
+#include "softuart.h"
+
+// the firmware's default table, see profile.c
+static const char ltrs[32] = {0,    'E', 0x0A, 'A', ' ', 'S', 'I', 'U',
+                              0x0D, 'D', 'R',  'J', 'N', 'F', 'C', 'K',
+                              'T',  'Z', 'L',  'W', 'H', 'Y', 'P', 'Q',
+                              'O',  'B', 'G',  0,   'M', 'X', 'V', 0};
+
+static const char figs[32] = {0,    '3', 0x0A, '-', ' ', '\'', '8', '7',
+                              0x0D, 0x05, '4', 0x07, ',', '$', ':',  '(',
+                              '5',  '+', ')',  '2', '#', '6',  '0', '1',
+                              '9',  '?', '&',  0,   '.', '/', '=',  0};
+
+static void show_char(char *out, int c) {
+  if (c == 0)
+    strcpy(out, "");
+  else if (c == '\r')
+    strcpy(out, "CR");
+  else if (c == '\n')
+    strcpy(out, "LF");
+  else if (c == 0x05)
+    strcpy(out, "WRU");
+  else if (c == 0x07)
+    strcpy(out, "BEL");
+  else if (c < 32 || c > 126)
+    sprintf(out, "\\x%02x", c & 0xff);
+  else
+    sprintf(out, "'%c'", c);
+}
+
+// known loop speeds, to name the nearest one
+static const double speeds[] = {45.45, 50, 56.9, 74.2, 110, 150, 300};
+#define NSPEEDS (sizeof(speeds) / sizeof(speeds[0]))
+
+#define MAXRUNS 100000
+
+static long runs[MAXRUNS]; // run lengths in samples, alternating levels
+static int nruns = 0;
+
+static void add_run(FILE *vcd, long start, int level, long len) {
+  if (vcd)
+    fprintf(vcd, "#%ld\n%d!\n", start, level);
+  if (nruns < MAXRUNS)
+    runs[nruns++] = len;
+}
+
+static int logic_decode(FILE *f, double rate, FILE *vcd) {
+  int c, n, i, level = -1, first_level = -1;
+  long pos = 0, run_start = 0, count;
+  long shortest = 0;
+  double bit, sum, units, best = 0;
+
+  if (vcd)
+    fprintf(vcd, "$timescale %.0f us $end\n$scope module loop $end\n"
+                 "$var wire 1 ! rx $end\n$upscope $end\n$enddefinitions $end\n",
+            1e6 / rate);
+
+  while ((c = fgetc(f)) != EOF) {
+    count = 1;
+    if ((c == 0x00) || (c == 0xFF)) {
+      if ((n = fgetc(f)) == EOF)
+        break;
+      count = n;
+    }
+    for (; count > 0; count--) {
+      for (i = 7; i >= 0; i--) {
+        if (((c >> i) & 1) != level) {
+          if (level >= 0) {
+            printf("%12.3f  %-5s %6ld samples\n", run_start * 1000.0 / rate,
+                   level ? "mark" : "space", pos - run_start);
+            add_run(vcd, run_start, level, pos - run_start);
+          } else
+            first_level = (c >> i) & 1;
+          level = (c >> i) & 1;
+          run_start = pos;
+        }
+        pos++;
+      }
+    }
+  }
+  if (level >= 0)
+    add_run(vcd, run_start, level, pos - run_start);
+  if (vcd)
+    fprintf(vcd, "#%ld\n", pos);
+
+  printf("\n%ld samples (%.1f s), %d runs, starting with %s\n", pos,
+         pos / rate, nruns, first_level ? "mark" : "space");
+
+  // The first and last runs are cut off by the capture, skip them. The
+  // shortest run is about one bit; then refine by fitting every run that is
+  // a small whole number of bits.
+  for (i = 1; i < nruns - 1; i++)
+    if ((shortest == 0) || (runs[i] < shortest))
+      shortest = runs[i];
+  if (shortest == 0) {
+    printf("not enough edges to estimate the baud rate\n");
+    return 0;
+  }
+  sum = 0;
+  units = 0;
+  for (i = 1; i < nruns - 1; i++) {
+    n = (int)floor((double)runs[i] / shortest + 0.5);
+    if (n >= 1 && n <= 9) {
+      sum += runs[i];
+      units += n;
+    }
+  }
+  bit = sum / units;
+  printf("bit time %.2f samples, about %.1f baud", bit, rate / bit);
+  for (i = 0; i < (int)NSPEEDS; i++)
+    if ((best == 0) ||
+        (fabs(speeds[i] - rate / bit) < fabs(best - rate / bit)))
+      best = speeds[i];
+  if (fabs(best - rate / bit) / best < 0.1)
+    printf(" (nearest standard %g)", best);
+  printf("\n");
+  return 0;
+}
+
+static int record_decode(FILE *f) {
+  unsigned char hdr[LINE_HDRLEN];
+  char text[256];
+  int c, more = 0;
+  unsigned long lines = 0, records = 0, skipped = 0;
+
+  while ((c = fgetc(f)) != EOF) {
+    if (c != LINE_SYNC) {
+      skipped++;
+      continue;
+    }
+    hdr[0] = c;
+    if ((fread(hdr + 1, 1, LINE_HDRLEN - 1, f) < LINE_HDRLEN - 1) ||
+        (fread(text, 1, hdr[2], f) < hdr[2]))
+      break;
+    text[hdr[2]] = 0;
+    records++;
+    if (!more)
+      printf("%12.3f  ",
+             (hdr[3] | (hdr[4] << 8) | ((uint32_t)hdr[5] << 16)) / 1000.0);
+    fputs(text, stdout);
+    more = hdr[1] & LINE_MORE;
+    if (!more) {
+      putchar('\n');
+      lines++;
+    }
+  }
+  if (more)
+    putchar('\n');
+  printf("\n%lu lines in %lu records", lines, records);
+  if (skipped)
+    printf(", %lu bytes skipped out of sync", skipped);
+  printf("\n");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  FILE *f = stdin, *vcd = NULL;
+  double rate = 0;
+  int opt, records = 0;
+  unsigned char rec[CAP_RECLEN];
+  int c, n;
+  uint32_t t, wrap = 0, prev_raw = 0;
+  unsigned long frames = 0, fe = 0, brk = 0, skipped = 0;
+  uint64_t when, first = 0, last = 0, gaps = 0;
+  uint32_t mingap = 0xFFFFFFFF;
+  char shown[16];
+
+  while ((opt = getopt(argc, argv, "l:rv:")) != -1) {
+    switch (opt) {
+    case 'r':
+      records = 1;
+      break;
+    case 'l':
+      rate = atof(optarg);
+      break;
+    case 'v':
+      vcd = fopen(optarg, "w");
+      if (vcd == NULL) {
+        perror(optarg);
+        return 1;
+      }
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-l rate [-v out.vcd] | -r] [file]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (optind < argc) {
+    f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+  if (rate > 0)
+    return logic_decode(f, rate, vcd);
+  if (records)
+    return record_decode(f);
+
+  printf("    time (s)   delta (ms)  code  shift  char   flags\n");
+  while ((c = fgetc(f)) != EOF) {
+    if (c != CAP_SYNC) { // lost sync, e.g. text before capture mode started
+      skipped++;
+      continue;
+    }
+    rec[0] = c;
+    n = fread(rec + 1, 1, CAP_RECLEN - 1, f);
+    if (n < CAP_RECLEN - 1)
+      break;
+
+    t = rec[3] | (rec[4] << 8) | ((uint32_t)rec[5] << 16);
+    // the timestamp is 24 bits of milliseconds, about 4.6 hours
+    if (frames && t < prev_raw)
+      wrap += 1;
+    prev_raw = t;
+    when = ((uint64_t)wrap << 24) + t;
+    if (frames == 0)
+      first = when;
+
+    if (rec[1] & CAP_8BIT)
+      show_char(shown, rec[2] & 0x7F);
+    else if (rec[2] == 0x1F)
+      strcpy(shown, "LTRS");
+    else if (rec[2] == 0x1B)
+      strcpy(shown, "FIGS");
+    else
+      show_char(shown, (rec[1] & CAP_FIGS) ? figs[rec[2] & 0x1F]
+                                           : ltrs[rec[2] & 0x1F]);
+
+    printf("%12.3f %12lu  0x%02x  %-5s  %-5s  %s%s%s%s\n",
+           (double)(when - first) / 1000.0,
+           frames ? (unsigned long)(when - last) : 0UL, rec[2],
+           (rec[1] & CAP_8BIT) ? "-" : ((rec[1] & CAP_FIGS) ? "FIGS" : "LTRS"),
+           shown, (rec[1] & SOFTUART_FE) ? "framing " : "",
+           (rec[1] & SOFTUART_BREAK) ? "break " : "",
+           (rec[1] & SOFTUART_ECHO) ? "echo" : "",
+           (rec[1] & SOFTUART_COLLISION) ? "collision" : "");
+
+    if (frames) {
+      gaps += when - last;
+      if (when - last < mingap)
+        mingap = when - last;
+    }
+    if (rec[1] & SOFTUART_FE)
+      fe++;
+    if (rec[1] & SOFTUART_BREAK)
+      brk++;
+    last = when;
+    frames++;
+  }
+
+  printf("\n%lu frames, %lu framing errors, %lu break frames", frames, fe,
+         brk);
+  if (skipped)
+    printf(", %lu bytes skipped out of sync", skipped);
+  printf("\n");
+  if (frames > 1) {
+    printf("shortest gap %u ms, average %.1f ms, %.2f chars/s\n", mingap,
+           (double)gaps / (frames - 1),
+           (frames - 1) * 1000.0 / (double)(last - first));
+  }
+  return 0;
+}
@@ -0,0 +1,1011 @@
+/* Interactive configuration command line.
+ *
+ * Commands and boolean settings are each described by a table in flash,
+ * sorted by name, so a word is looked up with a binary search instead of
+ * being strncmp()ed against every command. Any unambiguous prefix of a name
+ * works, e.g. "sh" for show, "statu" for status or "notr" for notranslate. */
+
+#include "cmdline.h"
+#include "conf.h"
+#include "config.h"
+#include "lineout.h"
+#include "lufa_serial.h"
+#include "main.h"
+#include "out.h"
+#include "profile.h"
+#include "rxout.h"
+#include "shift.h"
+#include "softuart.h"
+#include "stats.h"
+#include "tick.h"
+#include "usb_serial_getstr.h"
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+#ifdef INCLUDE_AUTOPRINT
+#include "autoprint.h"
+#include "sched.h"
+#endif
+#ifdef INCLUDE_AUTOBAUD
+#include "autobaud.h"
+#endif
+#ifdef INCLUDE_HWUART
+#include "hwuart.h"
+#endif
+
+extern uint16_t confflags;      // from main.c
+extern uint32_t boot_usb_ms;    // from main.c
+extern uint32_t boot_config_ms; // from main.c
+extern uint8_t esc_char;        // from escape.c
+extern uint16_t esc_guard;      // from escape.c
+extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface; // from main.c
+
+#define CMD_NAMELEN 10
+#define CMD_HELPLEN 27
+
+#define CMD_NONE 0xFF
+#define CMD_AMBIGUOUS 0xFE
+
+#define CMD_HIDDEN (1 << 0) // leave out of help
+
+struct command {
+  char name[CMD_NAMELEN];
+  void (*handler)(void);
+  uint8_t flags;
+};
+
+// a confflags bit that can be turned on with "name" and off with "noname"
+struct flag {
+  char name[CMD_NAMELEN];
+  uint16_t bit;
+  char help[CMD_HELPLEN];
+};
+
+static uint8_t cmd_done; // set by "exit"
+
+static void cmd_autobaud(void);
+static void cmd_automsg(void);
+static void cmd_baud(void);
+static void cmd_eedump(void);
+static void cmd_eewipe(void);
+static void cmd_eewrite(void);
+static void cmd_escape(void);
+static void cmd_exit(void);
+static void cmd_fill(void);
+static void cmd_guard(void);
+static void cmd_load(void);
+static void cmd_passthru(void);
+static void cmd_profile(void);
+static void cmd_resync(void);
+static void cmd_rxmode(void);
+static void cmd_save(void);
+static void cmd_sched(void);
+static void cmd_show(void);
+static void cmd_stats(void);
+static void cmd_status(void);
+static void cmd_table(void);
+static void cmd_tget(void);
+static void cmd_tput(void);
+static void cmd_uart(void);
+static void cmd_width(void);
+
+// must stay sorted by name, cmd_find() does a binary search
+static const struct command commands[] PROGMEM = {
+#ifdef INCLUDE_AUTOBAUD
+    {"autobaud", cmd_autobaud, 0},
+#endif
+#ifdef INCLUDE_AUTOPRINT
+    {"automsg", cmd_automsg, 0},
+#endif
+    {"baud", cmd_baud, 0},
+    {"eedump", cmd_eedump, 0},
+    {"eewipe", cmd_eewipe, 0},
+#ifdef EEWRITE
+    // leave this undocumented, it's not very safe, but might be useful
+    {"eewrite", cmd_eewrite, CMD_HIDDEN},
+#endif
+    {"escape", cmd_escape, 0},
+    {"exit", cmd_exit, 0},
+    {"fill", cmd_fill, 0},
+    {"guard", cmd_guard, 0},
+    {"help", help, 0},
+    {"load", cmd_load, 0},
+    {"passthru", cmd_passthru, 0},
+    {"profile", cmd_profile, 0},
+    {"resync", cmd_resync, 0},
+    {"rxmode", cmd_rxmode, 0},
+    {"save", cmd_save, 0},
+#ifdef INCLUDE_AUTOPRINT
+    {"sched", cmd_sched, 0},
+#endif
+    {"show", cmd_show, 0},
+    {"stats", cmd_stats, 0},
+    {"status", cmd_status, 0},
+    {"table", cmd_table, 0},
+    {"tget", cmd_tget, 0},
+    {"tput", cmd_tput, 0},
+#ifdef INCLUDE_HWUART
+    {"uart", cmd_uart, 0},
+#endif
+    {"width", cmd_width, 0},
+};
+#define NCOMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+// confflags settings. This has the potential to turn into a mess, try to
+// keep the number of config settings to a minimum, especially ones that
+// impact each other. Also sorted by name.
+static const struct flag flags[] PROGMEM = {
+    {"8bit", CONF_8BIT, "8bit mode"},
+    {"autocr", CONF_AUTOCR, "Send CRLF at end of line"},
+#ifdef INCLUDE_AUTOPRINT
+    {"autoprint", CONF_AUTOPRINT, "Print saved text on break"},
+#endif
+    {"crlf", CONF_CRLF, "CR or LF --> CR+LF"},
+    {"dropecho", CONF_DROPECHO, "Drop our own echo"},
+    {"halfduplex", CONF_HALFDUPLEX, "Loop echoes what we send"},
+    {"showbreak", CONF_SHOWBREAK, "Display received breaks"},
+    {"spool", CONF_SPOOL, "Hold text while loop down"},
+    {"translate", CONF_TRANSLATE, "Translate ASCII/Baudot"},
+    {"usos", CONF_UNSHIFT_ON_SPACE, "Unshift on space"},
+#ifdef INCLUDE_UTF8
+    {"utf8", CONF_UTF8, "Transliterate UTF-8 input"},
+    {"utf8out", CONF_UTF8OUT, "Bell, WRU to host as UTF-8"},
+#endif
+    {"wordwrap", CONF_WORDWRAP, "Break lines at spaces"},
+};
+#define NFLAGS (sizeof(flags) / sizeof(flags[0]))
+
+// Look word up in a sorted table of structs that start with a name. Returns
+// the index of an exact match, or of the only entry word is a prefix of.
+// *exact says which one it was.
+static uint8_t cmd_find(const char *word, const void *table, uint8_t n,
+                        uint8_t size, uint8_t *exact) {
+  uint8_t lo = 0, hi = n, mid;
+  size_t len = strlen(word);
+  const char *name;
+
+  *exact = 0;
+  // find the first entry >= word, all prefix matches follow it
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    name = (const char *)table + mid * size;
+    if (strcmp_P(word, name) > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo >= n)
+    return CMD_NONE;
+  name = (const char *)table + lo * size;
+  if (strcmp_P(word, name) == 0) {
+    *exact = 1;
+    return lo;
+  }
+  if (strncmp_P(word, name, len) != 0)
+    return CMD_NONE;
+  if ((lo + 1 < n) && (strncmp_P(word, name + size, len) == 0))
+    return CMD_AMBIGUOUS;
+  return lo;
+}
+
+static void read_flag(uint8_t i, struct flag *f) {
+  memcpy_P(f, &flags[i], sizeof(*f));
+}
+
+static void flag_set(uint8_t i, uint8_t on) {
+  struct flag f;
+  struct config saved;
+
+  read_flag(i, &f);
+  if (on)
+    confflags |= f.bit;
+  else
+    confflags &= ~f.bit;
+
+  if (f.bit == CONF_8BIT) {
+    // turning on 8bit mode forces translate mode off.
+    // But on turning off 8bit mode, do we force translate mode on? I think
+    // it's better to revert to whatever setting the user has previously
+    // saved.
+    if (on) {
+      confflags &= ~CONF_TRANSLATE;
+    } else {
+      config_read(&saved);
+      if (saved.confflags & CONF_TRANSLATE)
+        confflags |= CONF_TRANSLATE;
+    }
+  }
+  out_str(f.help);
+  out_str_P(on ? PSTR(": on\r\n") : PSTR(": off\r\n"));
+}
+
+// Run one command line. Returns 0 if the command wasn't recognized.
+uint8_t cmd_execute(char *line) {
+  char *word;
+  uint8_t c, f, nf = CMD_NONE;
+  uint8_t c_exact, f_exact, nf_exact = 0;
+  struct command cmd;
+
+  word = strtok(line, " ");
+  if (word == NULL)
+    return 1;
+
+  c = cmd_find(word, commands, NCOMMANDS, sizeof(struct command), &c_exact);
+  f = cmd_find(word, flags, NFLAGS, sizeof(struct flag), &f_exact);
+  if (strncmp(word, "no", 2) == 0)
+    nf = cmd_find(word + 2, flags, NFLAGS, sizeof(struct flag), &nf_exact);
+
+  // an exact name always wins over an abbreviation of something else
+  if (!(c_exact || f_exact || nf_exact)) {
+    if ((c == CMD_AMBIGUOUS) || (f == CMD_AMBIGUOUS) ||
+        (nf == CMD_AMBIGUOUS) ||
+        ((c != CMD_NONE) + (f != CMD_NONE) + (nf != CMD_NONE) > 1)) {
+      out_str_P(PSTR("Ambiguous command.\r\n"));
+      return 1;
+    }
+  }
+
+  if ((c != CMD_NONE) && (c_exact || !(f_exact || nf_exact))) {
+    memcpy_P(&cmd, &commands[c], sizeof(cmd));
+    cmd.handler();
+  } else if ((f != CMD_NONE) && (f_exact || !nf_exact)) {
+    flag_set(f, 1);
+  } else if (nf != CMD_NONE) {
+    flag_set(nf, 0);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+void commandline(void) {
+  uint8_t n;
+  static char buf[CMDBUFLEN]; // command line input buffer
+
+  softuart_turn_rx_off();
+  help();
+
+  cmd_done = 0;
+  while (!cmd_done) {
+    out_str_P(PSTR("cmd> "));
+    memset(buf, 0, CMDBUFLEN);
+
+    n = usb_serial_getstr(buf, CMDBUFLEN - 1);
+    out_crlf();
+    if (n == 0)
+      continue;
+    if (!cmd_execute(buf))
+      out_str_P(PSTR("No such command.\r\n"));
+  }
+}
+
+void help(void) {
+  uint8_t i;
+  struct command cmd;
+  struct flag f;
+
+  out_str_P(PSTR("\r\nCommands available:\r\n"));
+  for (i = 0; i < NCOMMANDS; i++) {
+    memcpy_P(&cmd, &commands[i], sizeof(cmd));
+    if (!(cmd.flags & CMD_HIDDEN)) {
+      out_str(cmd.name);
+      out_str_P(PSTR(", "));
+    }
+  }
+  out_crlf();
+  for (i = 0; i < NFLAGS; i++) {
+    read_flag(i, &f);
+    out_str_P(i ? PSTR(", [no]") : PSTR("[no]"));
+    out_str(f.name);
+  }
+  out_str_P(PSTR("\r\nAny unambiguous abbreviation works.\r\n"));
+}
+
+#ifdef INCLUDE_AUTOBAUD
+// "autobaud [seconds]", listen to the loop and guess its speed
+static void cmd_autobaud(void) {
+  char *res;
+  uint8_t seconds = 10;
+
+  res = strtok(NULL, " ");
+  if (res != NULL)
+    seconds = atoi(res);
+  if (seconds == 0)
+    seconds = 10;
+  autobaud(seconds);
+}
+#endif
+
+#ifdef INCLUDE_AUTOPRINT
+static void cmd_automsg(void) { create_automsg(); }
+#endif
+
+static void cmd_exit(void) {
+  out_str_P(PSTR("Returning to adapter mode.\r\n"));
+  softuart_turn_rx_on();
+  cmd_done = 1;
+}
+
+// save/load/show settings
+static void cmd_save(void) {
+  config_save();
+  out_str_P(PSTR("Settings saved.\r\n"));
+}
+
+static void cmd_load(void) {
+  if (config_load())
+    out_str_P(PSTR("Settings loaded.\r\n"));
+  else
+    out_str_P(PSTR("No saved settings, using defaults.\r\n"));
+}
+
+// like "2+1/20 ltrs"
+static void show_fill(uint8_t n, uint8_t cols, uint8_t type) {
+  out_dec(n);
+  if (cols) {
+    out_str_P(PSTR("+1/"));
+    out_dec(cols);
+  }
+  out_str_P((type == FILL_GAP)   ? PSTR(" gap")
+            : (type == FILL_NUL) ? PSTR(" nul")
+                                 : PSTR(" ltrs"));
+}
+
+// like "break line 20ch 60s", or "off"
+static void show_resync(uint8_t flags, uint8_t chars, uint16_t idle) {
+  if (!flags && !chars && !idle)
+    out_str_P(PSTR("off"));
+  if (flags & RESYNC_BREAK)
+    out_str_P(PSTR("break "));
+  if (flags & RESYNC_LINE)
+    out_str_P(PSTR("line "));
+  if (chars)
+    out_msg(PSTR(""), chars, PSTR("ch "));
+  if (idle)
+    out_msg(PSTR(""), idle, PSTR("s "));
+}
+
+#ifdef INCLUDE_AUTOPRINT
+// like "every 60m idle 300s", or "off"
+static void show_sched(uint16_t every, uint16_t idle) {
+  if (!every && !idle)
+    out_str_P(PSTR("off"));
+  if (every)
+    out_msg(PSTR("every "), every, PSTR("m "));
+  if (idle)
+    out_msg(PSTR("idle "), idle, PSTR("s "));
+}
+#endif
+
+// what "rxmode" was given, for show
+static PGM_P show_rxmode(uint8_t mode, uint8_t stamp) {
+  switch (mode) {
+  case RXMODE_LINE:
+    return stamp ? PSTR("stamp") : PSTR("line");
+  case RXMODE_RECORD:
+    return PSTR("record");
+  case RXMODE_CAPTURE:
+    return PSTR("capture");
+  case RXMODE_LOGIC:
+    return PSTR("logic");
+  }
+  return PSTR("char");
+}
+
+// one "label  cur  saved" line of show, with gap between the two
+static void show_nums(PGM_P label, uint16_t cur, PGM_P gap, uint16_t saved) {
+  out_str_P(label);
+  out_dec(cur);
+  out_str_P(gap);
+  out_dec(saved);
+  out_crlf();
+}
+
+static void cmd_show(void) {
+  uint8_t i;
+  struct config saved;
+  struct flag f;
+  char label[CMD_HELPLEN + 1];
+
+  config_read(&saved);
+  out_str_P(
+      PSTR("Settings:                                  Cur     Saved\r\n"));
+  for (i = 0; i < NFLAGS; i++) {
+    read_flag(i, &f);
+    strcpy(label, f.help);
+    strcat(label, ":");
+    out_str_P(PSTR("[no]"));
+    out_field(f.name, 12);
+    out_field(label, 27);
+    out_char((confflags & f.bit) ? 'Y' : 'N');
+    out_str_P(PSTR("      "));
+    out_char((saved.confflags & f.bit) ? 'Y' : 'N');
+    out_crlf();
+  }
+
+  show_nums(PSTR("table N         Translation table number:  "),
+            profile_table[profile_cur], PSTR("      "),
+            saved.tables[profile_cur]);
+
+  out_msg(PSTR("profile N [T]   Tables in profiles 0-"), PROFILES - 1,
+          PSTR(":    "));
+  for (i = 0; i < PROFILES; i++)
+    out_dec(profile_table[i]);
+  out_str_P(PSTR("   "));
+  for (i = 0; i < PROFILES; i++)
+    out_dec(saved.tables[i]);
+  out_crlf();
+
+  show_nums(PSTR("baud N          Baud rate:                 "),
+            divisor_to_baud(OCR1A), PSTR("     "),
+            divisor_to_baud(saved.bauddiv));
+
+  out_str_P(PSTR("escape C|off    Inline command escape:     "));
+  out_char(esc_char ? esc_char : '-');
+  out_str_P(PSTR("      "));
+  out_char(saved.esc_char ? saved.esc_char : '-');
+  out_crlf();
+
+  show_nums(PSTR("guard N         Escape guard time (ms):    "), esc_guard,
+            PSTR("    "), saved.esc_guard);
+
+  show_nums(PSTR("width N         Line width:                "), linewidth,
+            PSTR("     "), saved.linewidth);
+
+  out_str_P(PSTR("fill N [C] T    Fill after CR:             "));
+  show_fill(crfill, crfill_cols, fillchar);
+  out_str_P(PSTR("  "));
+  show_fill(saved.crfill, saved.crfill_cols, saved.fillchar);
+  out_crlf();
+
+  out_str_P(PSTR("resync ...      Forget shift after:        "));
+  show_resync(resync, resync_chars, resync_idle);
+  out_str_P(PSTR(" / "));
+  show_resync(saved.resync, saved.resync_chars, saved.resync_idle);
+  out_crlf();
+
+#ifdef INCLUDE_AUTOPRINT
+  out_str_P(PSTR("sched ...       Print automsg:             "));
+  show_sched(sched_every, sched_idle);
+  out_str_P(PSTR(" / "));
+  show_sched(saved.sched_every, saved.sched_idle);
+  out_crlf();
+#endif
+
+  out_str_P(PSTR("rxmode ...      Received text to host:     "));
+  out_field_P(show_rxmode(rxmode, rxstamp), 7);
+  out_str_P(show_rxmode(saved.rxmode, saved.rxstamp));
+  out_crlf();
+
+#ifdef INCLUDE_HWUART
+  out_str_P(PSTR("uart soft|hw    Loop UART, hw 244+ baud:   "));
+  out_str_P((confflags & CONF_HWUART) ? PSTR("hw  ") : PSTR("soft"));
+  out_str_P(PSTR("   "));
+  out_str_P((saved.confflags & CONF_HWUART) ? PSTR("hw  ") : PSTR("soft"));
+  out_crlf();
+#endif
+}
+
+static void cmd_status(void) {
+  out_str_P(PSTR("USB configured at "));
+  out_dec(boot_usb_ms);
+  out_str_P(PSTR(" ms, settings ready at "));
+  out_dec(boot_config_ms);
+  out_str_P(PSTR(" ms."));
+  out_crlf();
+  softuart_status();
+}
+
+// "stats" shows the counters, "stats reset" clears them
+static void cmd_stats(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if ((res != NULL) && (strcmp_P(res, PSTR("reset")) == 0)) {
+    stats_reset();
+    out_str_P(PSTR("Counters cleared.\r\n"));
+  } else
+    stats_print();
+}
+
+// "rxmode char" is normal operation, "rxmode line [stamp]" and "rxmode
+// record" send whole lines (see rxout.c), "rxmode capture" switches to binary
+// timestamped records and "rxmode logic" to raw pin samples (use the inline
+// escape to get back out).
+static void cmd_rxmode(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_str_P(PSTR("rxmode <char|line [stamp]|record"));
+#ifdef INCLUDE_CAPTURE
+    out_str_P(PSTR("|capture"));
+#endif
+#ifdef INCLUDE_LOGIC
+    out_str_P(PSTR("|logic"));
+#endif
+    out_str_P(PSTR(">\r\n"));
+    return;
+  }
+  if (strcmp_P(res, PSTR("char")) == 0) {
+    rxout_set_mode(RXMODE_CHAR);
+    out_str_P(PSTR("Received text passed through as it arrives.\r\n"));
+  } else if (strcmp_P(res, PSTR("line")) == 0) {
+    res = strtok(NULL, " ");
+    rxstamp = (res != NULL) && (strcmp_P(res, PSTR("stamp")) == 0);
+    rxout_set_mode(RXMODE_LINE);
+    out_str_P(rxstamp ? PSTR("Received text sent a line at a time, "
+                             "timestamped.\r\n")
+                      : PSTR("Received text sent a line at a time.\r\n"));
+  } else if (strcmp_P(res, PSTR("record")) == 0) {
+    out_str_P(PSTR("Received lines sent as records.\r\n"));
+    rxout_set_mode(RXMODE_RECORD);
+#ifdef INCLUDE_CAPTURE
+  } else if (strcmp_P(res, PSTR("capture")) == 0) {
+    out_str_P(PSTR("Received frames sent as capture records.\r\n"));
+    rxout_set_mode(RXMODE_CAPTURE);
+#endif
+#ifdef INCLUDE_LOGIC
+  } else if (strcmp_P(res, PSTR("logic")) == 0) {
+#ifdef INCLUDE_HWUART
+    if (hwuart_on) {
+      out_str_P(PSTR("Logic mode needs the soft UART.\r\n"));
+      return;
+    }
+#endif
+    // the host needs the rate to make sense of the samples
+    out_msg(PSTR("Sampling RX at "), F_CPU / 64 / OCR1A, PSTR(" Hz.\r\n"));
+    rxout_set_mode(RXMODE_LOGIC);
+#endif
+  } else
+    out_str_P(PSTR("Unknown rx mode.\r\n"));
+}
+
+static void cmd_passthru(void) {
+  confflags &= ~CONF_TRANSLATE;
+  out_str_P(PSTR("Set to passthru mode.\r\n"));
+}
+
+static void cmd_baud(void) {
+  char *res;
+  uint16_t divisor;
+
+  res = strtok(NULL, " ");
+  if (res != NULL) {
+    divisor = baud_to_divisor(atoi(res));
+    // if user entered a nonstandard baud rate, wing it.
+    if (divisor == 0) {
+      out_str_P(PSTR("Nonstandard baud rate selected, winging it.\r\n"));
+      divisor = F_CPU / 64 / 3 / (unsigned long)atoi(res);
+    }
+    out_str_P(PSTR("Baud rate set to "));
+    out_str(res);
+    out_msg(PSTR(" (divisor "), divisor, PSTR(")\r\n"));
+#ifdef INCLUDE_HWUART
+    if (hwuart_on) {
+      set_softuart_divisor(divisor);
+      if (!hwuart_on)
+        out_str_P(PSTR("Too slow for the USART (244 baud minimum), loop "
+                       "moved to the soft UART.\r\n"));
+      return;
+    }
+#endif
+    set_softuart_divisor(divisor);
+  } else {
+    out_str_P(PSTR("baud <45|50|56|75>\r\n"));
+  }
+}
+
+// put table n in profile p
+static void set_table(uint8_t p, int n) {
+  if ((n < 0) || (n >= TABLES)) {
+    out_msg(PSTR("Table numbers are 0 - "), TABLES - 1,
+            PSTR("; selecting 0.\r\n"));
+    n = 0;
+  }
+  profile_table[p] = n;
+  profile_load(p);
+  out_msg(PSTR("Selected translation table #"), n, PSTR(" ("));
+  out_msg(PSTR(""), profile_width[p],
+          (n < TABLES_EEP) ? PSTR(" bit)\r\n") : PSTR(" bit, flash)\r\n"));
+}
+
+// the table for the profile in use now
+static void cmd_table(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res != NULL)
+    set_table(profile_cur, atoi(res));
+  else {
+    out_msg(PSTR("table <0-"), TABLES - 1, PSTR(">, "));
+    out_msg(PSTR(""), TABLES_EEP, PSTR(" and up are in flash\r\n"));
+  }
+}
+
+// "profile N" switches to profile N, "profile N T" puts table T in it first.
+// From adapter mode the host uses SO N / SI instead, see profile.c.
+static void cmd_profile(void) {
+  char *res;
+  int p;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_msg(PSTR("profile <0-"), PROFILES - 1, PSTR("> [table]\r\n"));
+    return;
+  }
+  p = atoi(res);
+  if ((p < 0) || (p >= PROFILES)) {
+    out_msg(PSTR("Profiles are 0 - "), PROFILES - 1, PSTR(".\r\n"));
+    return;
+  }
+  res = strtok(NULL, " ");
+  if (res != NULL)
+    set_table(p, atoi(res));
+  profile_select(p);
+  out_msg(PSTR("Using profile "), p, PSTR(" (table "));
+  out_msg(PSTR(""), profile_table[p], PSTR(")\r\n"));
+}
+
+/* Whole tables in one go, for tablectl (or anything else that speaks the
+ * format): a line per TABLE_LINE bytes, ':' then the offset and the bytes
+ * in hex, then '.' and the CRC-16 of the whole table (CCITT from 0xFFFF,
+ * like the settings). "tget T" sends table T like that. "tput T" takes one,
+ * without echoing it, checks it with table_check() and writes it to the
+ * eeprom. Anything else, or TABLE_TIMEOUT ms without a line, gives up. */
+#define TABLE_LINE 32
+#define TABLE_TIMEOUT 10000
+
+// the table number argument, or -1
+static int table_arg(void) {
+  char *res;
+  int n;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_msg(PSTR("Which table? 0-"), TABLES - 1, PSTR("\r\n"));
+    return -1;
+  }
+  n = atoi(res);
+  if ((n < 0) || (n >= TABLES)) {
+    out_msg(PSTR("Table numbers are 0 - "), TABLES - 1, PSTR(".\r\n"));
+    return -1;
+  }
+  return n;
+}
+
+static uint16_t table_crc(const char *t, uint8_t size) {
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  for (i = 0; i < size; i++)
+    crc = _crc_ccitt_update(crc, t[i]);
+  return crc;
+}
+
+static void cmd_tget(void) {
+  char t[TABLE_MAX];
+  uint8_t size, i;
+  int n;
+
+  if ((n = table_arg()) < 0)
+    return;
+  size = table_get(n, t);
+  for (i = 0; i < size; i++) {
+    if (!(i % TABLE_LINE)) {
+      out_char(':');
+      out_hex8(i);
+    }
+    out_hex8(t[i]);
+    if ((i % TABLE_LINE) == TABLE_LINE - 1)
+      out_crlf();
+  }
+  out_char('.');
+  out_hex16(table_crc(t, size));
+  out_crlf();
+}
+
+// value of n hex digits at s, or -1
+static int32_t hex_in(const char *s, uint8_t n) {
+  int32_t v = 0;
+  char c;
+
+  while (n--) {
+    c = *s++;
+    if ((c >= '0') && (c <= '9'))
+      c -= '0';
+    else if ((c >= 'A') && (c <= 'F'))
+      c -= 'A' - 10;
+    else if ((c >= 'a') && (c <= 'f'))
+      c -= 'a' - 10;
+    else
+      return -1;
+    v = (v << 4) | c;
+  }
+  return v;
+}
+
+// Read a non-empty line from the host into s, without echo. Returns 0 if
+// none came within TABLE_TIMEOUT ms.
+static uint8_t table_line(char *s, uint8_t max) {
+  uint32_t start = millis();
+  uint8_t i = 0;
+  int16_t c;
+
+  while (millis() - start < TABLE_TIMEOUT) {
+    c = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
+    if (c < 0) {
+      usbserial_tasks();
+      continue;
+    }
+    if ((c == '\r') || (c == '\n')) {
+      if (i) {
+        s[i] = 0;
+        return 1;
+      }
+    } else if (i < max - 1)
+      s[i++] = c;
+  }
+  return 0;
+}
+
+static void cmd_tput(void) {
+  char t[TABLE_MAX];
+  char line[4 + 2 * TABLE_LINE];
+  uint8_t len = 0, size = TABLE_MAX, i, at;
+  int32_t v;
+  int n;
+  PGM_P err;
+
+  if ((n = table_arg()) < 0)
+    return;
+  if (n >= TABLES_EEP) {
+    out_msg(PSTR("Table "), n, PSTR(" is in flash.\r\n"));
+    return;
+  }
+  out_msg(PSTR("Send table "), n, PSTR(".\r\n"));
+  for (;;) {
+    if (!table_line(line, sizeof(line))) {
+      out_str_P(PSTR("Timed out.\r\n"));
+      return;
+    }
+    if (line[0] == '.')
+      break;
+    if ((line[0] != ':') || (hex_in(line + 1, 2) != len)) {
+      out_str_P(PSTR("Expected :"));
+      out_hex8(len);
+      out_str_P(PSTR("...\r\n"));
+      return;
+    }
+    for (i = 3; line[i]; i += 2) {
+      if (((v = hex_in(line + i, 2)) < 0) || (len >= size)) {
+        out_msg(PSTR("Bad data at byte "), len, PSTR(".\r\n"));
+        return;
+      }
+      t[len++] = v;
+      if (len == 1)
+        size = table_size(t[0]);
+    }
+  }
+  if (len != size) {
+    out_msg(PSTR("Got "), len, PSTR(" bytes, want "));
+    out_msg(PSTR(""), size, PSTR(".\r\n"));
+    return;
+  }
+  if (hex_in(line + 1, 4) != table_crc(t, size)) {
+    out_str_P(PSTR("CRC mismatch, want "));
+    out_hex16(table_crc(t, size));
+    out_str_P(PSTR(".\r\n"));
+    return;
+  }
+  if ((err = table_check(t, &at)) != NULL) {
+    out_msg(PSTR("Rejected at byte "), at, PSTR(": "));
+    out_str_P(err);
+    out_crlf();
+    return;
+  }
+  if (!table_write(n, t)) {
+    out_msg(PSTR("A wide table doesn't fit at "), n, PSTR(".\r\n"));
+    return;
+  }
+  out_msg(PSTR("Table "), n, PSTR(" written, CRC "));
+  out_hex16(table_crc(t, size));
+  out_crlf();
+}
+
+#ifdef INCLUDE_HWUART
+// "uart hw" moves the loop to USART1 (PD2/PD3), "uart soft" back to the
+// bit banged pins. See hwuart.c for what the hardware can't do.
+static void cmd_uart(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_str_P(hwuart_on ? PSTR("uart <soft|hw>, now hw\r\n")
+                        : PSTR("uart <soft|hw>, now soft\r\n"));
+    out_str_P(PSTR("hw only works at 244 baud and up.\r\n"));
+  } else if (strcmp_P(res, PSTR("hw")) == 0) {
+    if (hwuart_select(1))
+      out_str_P(PSTR("Loop on USART1.\r\n"));
+    else
+      out_str_P(PSTR("Too slow for the USART (244 baud minimum).\r\n"));
+  } else if (strcmp_P(res, PSTR("soft")) == 0) {
+    hwuart_select(0);
+    out_str_P(PSTR("Loop on soft UART.\r\n"));
+  } else
+    out_str_P(PSTR("uart <soft|hw>\r\n"));
+}
+#endif
+
+// "escape +" sets the character sent three times to get an inline command,
+// "escape off" disables it.
+static void cmd_escape(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_str_P(PSTR("escape <char|off>\r\n"));
+    return;
+  }
+  if (strcmp_P(res, PSTR("off")) == 0)
+    esc_char = 0;
+  else
+    esc_char = res[0];
+  if (esc_char) {
+    out_str_P(PSTR("Inline escape is "));
+    out_char(esc_char);
+    out_char(esc_char);
+    out_char(esc_char);
+    out_str_P(PSTR(".\r\n"));
+  } else
+    out_str_P(PSTR("Inline escape disabled.\r\n"));
+}
+
+static void cmd_guard(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res != NULL) {
+    esc_guard = atoi(res);
+    out_msg(PSTR("Escape guard time set to "), esc_guard, PSTR(" ms\r\n"));
+  } else
+    out_str_P(PSTR("guard <ms>\r\n"));
+}
+
+// "width 72", where autocr and wordwrap break lines
+static void cmd_width(void) {
+  char *res;
+  uint8_t n;
+
+  res = strtok(NULL, " ");
+  if (res != NULL) {
+    n = atoi(res);
+    if ((n < 10) || (n > LINEOUT_MAXWIDTH)) {
+      out_msg(PSTR("Width is 10 - "), LINEOUT_MAXWIDTH, PSTR(".\r\n"));
+      return;
+    }
+    linewidth = n;
+    out_msg(PSTR("Line width set to "), linewidth, PSTR("\r\n"));
+  } else
+    out_str_P(PSTR("width <columns>\r\n"));
+}
+
+// "fill N [C] [ltrs|nul|gap]": after every CR send N fill chars, plus one
+// per C columns the carriage travelled back, as LTRS, NUL or idle line.
+static void cmd_fill(void) {
+  char *res;
+  uint8_t n = 0;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_msg(PSTR("fill <0-"), LINEOUT_MAXFILL,
+            PSTR("> [columns per extra] [ltrs|nul|gap]\r\n"));
+    return;
+  }
+  for (; res != NULL; res = strtok(NULL, " ")) {
+    if (strcmp_P(res, PSTR("ltrs")) == 0)
+      fillchar = FILL_LTRS;
+    else if (strcmp_P(res, PSTR("nul")) == 0)
+      fillchar = FILL_NUL;
+    else if (strcmp_P(res, PSTR("gap")) == 0)
+      fillchar = FILL_GAP;
+    else if (n++ == 0)
+      crfill = (atoi(res) > LINEOUT_MAXFILL) ? LINEOUT_MAXFILL : atoi(res);
+    else
+      crfill_cols = atoi(res);
+  }
+  if (n == 1) // no column scaling given
+    crfill_cols = 0;
+  show_fill(crfill, crfill_cols, fillchar);
+  out_crlf();
+}
+
+// "resync [no]break [no]line chars N idle S": when to stop trusting the
+// shift we think the machine is in, see shift.c. "resync now" forgets it
+// straight away, "resync off" never does.
+static void cmd_resync(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_str_P(PSTR("resync [no]break [no]line chars <n> idle <s> | off | "
+                  "now\r\n"));
+    return;
+  }
+  for (; res != NULL; res = strtok(NULL, " ")) {
+    if (strcmp_P(res, PSTR("break")) == 0)
+      resync |= RESYNC_BREAK;
+    else if (strcmp_P(res, PSTR("nobreak")) == 0)
+      resync &= ~RESYNC_BREAK;
+    else if (strcmp_P(res, PSTR("line")) == 0)
+      resync |= RESYNC_LINE;
+    else if (strcmp_P(res, PSTR("noline")) == 0)
+      resync &= ~RESYNC_LINE;
+    else if ((strcmp_P(res, PSTR("chars")) == 0) &&
+             ((res = strtok(NULL, " ")) != NULL))
+      resync_chars = (atoi(res) > 255) ? 255 : atoi(res);
+    else if ((strcmp_P(res, PSTR("idle")) == 0) &&
+             ((res = strtok(NULL, " ")) != NULL))
+      resync_idle =
+          (atol(res) > RESYNC_MAXIDLE) ? RESYNC_MAXIDLE : atoi(res);
+    else if (strcmp_P(res, PSTR("off")) == 0) {
+      resync = 0;
+      resync_chars = 0;
+      resync_idle = 0;
+    } else if (strcmp_P(res, PSTR("now")) == 0)
+      shift_forget();
+    else {
+      out_str_P(PSTR("Unknown resync option.\r\n"));
+      return;
+    }
+  }
+  out_str_P(PSTR("Forget shift after: "));
+  show_resync(resync, resync_chars, resync_idle);
+  out_crlf();
+}
+
+#ifdef INCLUDE_AUTOPRINT
+// "sched every M idle S", either one, 0 or "off" to stop. See sched.c.
+static void cmd_sched(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res == NULL) {
+    out_str_P(PSTR("sched every <minutes> idle <seconds> | off\r\n"));
+    return;
+  }
+  for (; res != NULL; res = strtok(NULL, " ")) {
+    if ((strcmp_P(res, PSTR("every")) == 0) &&
+        ((res = strtok(NULL, " ")) != NULL))
+      sched_every = atoi(res);
+    else if ((strcmp_P(res, PSTR("idle")) == 0) &&
+             ((res = strtok(NULL, " ")) != NULL))
+      sched_idle = atoi(res);
+    else if (strcmp_P(res, PSTR("off")) == 0)
+      sched_every = sched_idle = 0;
+    else {
+      out_str_P(PSTR("Unknown sched option.\r\n"));
+      return;
+    }
+  }
+  sched_restart();
+  out_str_P(PSTR("Print automsg: "));
+  show_sched(sched_every, sched_idle);
+  out_crlf();
+}
+#endif
+
+static void cmd_eedump(void) { ee_dump(); }
+
+static void cmd_eewipe(void) { ee_wipe(); }
+
+#ifdef EEWRITE
+static void cmd_eewrite(void) {
+  char *res;
+
+  res = strtok(NULL, " ");
+  if (res != NULL)
+    ee_write(res);
+}
+#endif
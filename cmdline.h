@@ -0,0 +1,3 @@
+void commandline(void);
+uint8_t cmd_execute(char *line);
+void help(void);
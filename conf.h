@@ -6,20 +6,40 @@
 #define CONF_8BIT	 (1<<4)
 #define CONF_SHOWBREAK	 (1<<5)
 #define CONF_AUTOPRINT   (1<<6)
+#define CONF_HWUART	 (1<<7) // loop on USART1, set with "uart", not a flag
+#define CONF_WORDWRAP	 (1<<8)
+#define CONF_HALFDUPLEX	 (1<<9) // the loop brings back what we send
+#define CONF_DROPECHO	 (1<<10) // and the host doesn't want to see it
+#define CONF_UTF8	 (1<<11) // host sends UTF-8, see utf8.c
+#define CONF_UTF8OUT	 (1<<12) // and gets the bell etc. back as UTF-8
+#define CONF_SPOOL	 (1<<13) // hold host text while the loop is down
 
-#define EEP_CONFIGURED_LOCATION 0
-#define EEP_CONFIGURED_SIZE 2
-#define EEP_CONFIGURED_MAGIC 0x4545
-#define EEP_BAUDDIV_LOCATION 2
-#define EEP_BAUDDIV_SIZE 2
-#define EEP_CONFFLAGS_LOCATION 4
-#define EEP_CONFFLAGS_SIZE 1
-#define EEP_TABLE_SELECT_LOCATION 5
-#define EEP_TABLE_SELECT_SIZE 1
+// The saved settings (struct config, see config.h) rotate through
+// EEP_CONFIG_SLOTS slots at the start of eeprom.
+#define EEP_CONFIG_START 0
+#define EEP_CONFIG_SLOT_SIZE 32
+#define EEP_CONFIG_SLOTS 4
 
-// these will be used for multiple and/or redefinable translation tables
+// where older firmware kept its settings, only read to migrate them.
+#define EEP_LEGACY_CONFIGURED_LOCATION 0
+#define EEP_LEGACY_CONFIGURED_MAGIC 0x4545
+#define EEP_LEGACY_BAUDDIV_LOCATION 2
+#define EEP_LEGACY_CONFFLAGS_LOCATION 4
+#define EEP_LEGACY_TABLE_SELECT_LOCATION 5
+
+// translation tables, in EEP_TABLE_SIZE blocks up to the autoprint message
+// or the end of the eeprom. How many fit, and the ones in flash, are in
+// profile.h.
 #define EEP_TABLES_START 128
 #define EEP_TABLE_SIZE 64
 #define FIGS_OFFSET 32 // for each table, LTRS table is first, then FIGS table @32
-// atmega16u2 will have room for 6 tables, 32u2 will fit 14. Should be more than
-// enough. I'm not doing 6 bit support unless someone really reallly needs it. 
+
+// The autoprint message has the top half of the eeprom (0x200 on a 1K
+// part, as it always has). The offline spool's overflow is the last
+// EEP_SPOOL_SIZE bytes of that, only used while the saved message is
+// shorter (see spool.c). Everything follows E2END, from <avr/io.h>;
+// config.c checks that the regions don't overlap.
+#define EEP_AUTOMSG_SIZE ((E2END + 1) / 2)
+#define EEP_AUTOMSG_START (E2END + 1 - EEP_AUTOMSG_SIZE)
+#define EEP_SPOOL_SIZE 128
+#define EEP_SPOOL_START (E2END + 1 - EEP_SPOOL_SIZE)
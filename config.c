@@ -0,0 +1,219 @@
+/* Versioned, CRC checked configuration block, rotated through several eeprom
+ * slots so repeated saves don't wear out the same cells, and a torn write
+ * just falls back to the previous good copy. */
+
+#include "config.h"
+#include "conf.h"
+#include "lineout.h"
+#include "profile.h"
+#include "rxout.h"
+#include "shift.h"
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+
+// The eeprom regions in conf.h and profile.h, in order. They follow
+// E2END, so a part with less eeprom than they need shows up here.
+#if (EEP_CONFIG_START + EEP_CONFIG_SLOTS * EEP_CONFIG_SLOT_SIZE) >            \
+    EEP_TABLES_START
+#error "config slots overlap the translation tables"
+#endif
+#if (EEP_TABLES_START + EEP_TABLE_SIZE) > EEP_TABLES_END
+#error "no room in eeprom for a translation table"
+#endif
+#if defined(INCLUDE_AUTOPRINT) && (EEP_AUTOMSG_START < EEP_TABLES_END)
+#error "autoprint message overlaps the translation tables"
+#endif
+#if EEP_SPOOL_START < EEP_TABLES_END
+#error "spool overlaps the translation tables"
+#endif
+#if defined(INCLUDE_AUTOPRINT) && (EEP_SPOOL_START <= EEP_AUTOMSG_START)
+#error "spool leaves no room for the autoprint message"
+#endif
+
+#ifdef INCLUDE_AUTOPRINT
+#include "sched.h"
+#endif
+#ifdef INCLUDE_HWUART
+#include "hwuart.h"
+#endif
+
+extern uint16_t confflags; // from main.c
+extern uint8_t esc_char;   // from escape.c
+extern uint16_t esc_guard; // from escape.c
+void set_softuart_divisor(uint16_t);
+
+// make sure the block still fits when someone adds a field
+typedef char config_fits_in_slot[(sizeof(struct config) <= EEP_CONFIG_SLOT_SIZE)
+                                     ? 1
+                                     : -1];
+
+// slot the last good config was read from or written to, and its seq.
+static uint8_t config_slot = EEP_CONFIG_SLOTS - 1;
+static uint8_t config_seq = 0;
+
+static uint16_t config_crc(const struct config *c) {
+  const uint8_t *p = (const uint8_t *)c;
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+  for (i = 0; i < sizeof(struct config) - sizeof(c->crc); i++)
+    crc = _crc_ccitt_update(crc, p[i]);
+  return crc;
+}
+
+static uint8_t *config_slot_addr(uint8_t slot) {
+  return (uint8_t *)(EEP_CONFIG_START + slot * EEP_CONFIG_SLOT_SIZE);
+}
+
+void config_defaults(struct config *c) {
+  uint8_t p;
+
+  c->version = CONFIG_VERSION;
+  // c->bauddiv = 1833; // 45.45 baud
+  c->bauddiv = 1667; // 50 baud
+  // c->confflags = CONF_TRANSLATE | CONF_CRLF | CONF_SHOWBREAK;
+  c->confflags = CONF_TRANSLATE | CONF_CRLF;
+  for (p = 0; p < PROFILES; p++)
+    c->tables[p] = 0;
+  c->esc_char = '+';
+  c->esc_guard = 1000;
+  c->linewidth = 68;
+  c->crfill = 0;
+  c->crfill_cols = 0;
+  c->fillchar = FILL_LTRS;
+  c->resync = RESYNC_BREAK;
+  c->resync_chars = 0;
+  c->resync_idle = 0;
+  c->sched_every = 0;
+  c->sched_idle = 0;
+  c->rxmode = RXMODE_CHAR;
+  c->rxstamp = 0;
+}
+
+// Units configured by older firmware kept the settings at fixed offsets
+// behind a magic number. Pick those up so an upgrade doesn't lose them.
+static uint8_t config_read_legacy(struct config *c) {
+  if (eeprom_read_word((const uint16_t *)EEP_LEGACY_CONFIGURED_LOCATION) !=
+      EEP_LEGACY_CONFIGURED_MAGIC)
+    return 0;
+  config_defaults(c);
+  c->bauddiv = eeprom_read_word((const uint16_t *)EEP_LEGACY_BAUDDIV_LOCATION);
+  c->confflags =
+      eeprom_read_byte((const uint8_t *)EEP_LEGACY_CONFFLAGS_LOCATION);
+  c->tables[0] =
+      eeprom_read_byte((const uint8_t *)EEP_LEGACY_TABLE_SELECT_LOCATION);
+  return 1;
+}
+
+// Find the newest slot with a good crc and the current version. Returns 0 if
+// there isn't one, in which case *c is left holding defaults.
+uint8_t config_read(struct config *c) {
+  struct config tmp;
+  uint8_t slot, found = 0;
+
+  for (slot = 0; slot < EEP_CONFIG_SLOTS; slot++) {
+    eeprom_read_block(&tmp, config_slot_addr(slot), sizeof(tmp));
+    if ((tmp.version != CONFIG_VERSION) || (tmp.crc != config_crc(&tmp)))
+      continue;
+    // seq wraps, so compare by signed difference
+    if (!found || ((int8_t)(tmp.seq - c->seq) > 0)) {
+      *c = tmp;
+      config_slot = slot;
+      found = 1;
+    }
+  }
+  if (found) {
+    config_seq = c->seq;
+    return 1;
+  }
+  if (config_read_legacy(c))
+    return 1;
+  config_defaults(c);
+  return 0;
+}
+
+// Write into the slot after the one we last used. eeprom_update_block() skips
+// bytes that already hold the right value, which spares the cells further.
+void config_write(struct config *c) {
+  config_slot = (config_slot + 1) % EEP_CONFIG_SLOTS;
+  c->seq = ++config_seq;
+  c->version = CONFIG_VERSION;
+  c->crc = config_crc(c);
+  eeprom_update_block(c, config_slot_addr(config_slot), sizeof(*c));
+}
+
+// Read saved settings into the running config. Returns 0 if there were no
+// valid saved settings (the defaults are applied in that case).
+uint8_t config_load(void) {
+  struct config c;
+  uint8_t valid, p;
+
+  valid = config_read(&c);
+  confflags = c.confflags;
+  set_softuart_divisor(c.bauddiv);
+#ifdef INCLUDE_HWUART
+  hwuart_select(confflags & CONF_HWUART);
+#endif
+  for (p = 0; p < PROFILES; p++)
+    profile_table[p] = (c.tables[p] < TABLES) ? c.tables[p] : 0;
+  profile_load_all();
+  esc_char = c.esc_char;
+  esc_guard = c.esc_guard;
+  linewidth = c.linewidth;
+  crfill = c.crfill;
+  crfill_cols = c.crfill_cols;
+  fillchar = c.fillchar;
+  resync = c.resync;
+  resync_chars = c.resync_chars;
+  resync_idle = c.resync_idle;
+#ifdef INCLUDE_AUTOPRINT
+  sched_every = c.sched_every;
+  sched_idle = c.sched_idle;
+  sched_restart();
+#endif
+  rxstamp = c.rxstamp;
+  // a record mode saved by older firmware comes back as line mode too
+  rxout_set_mode(((c.rxmode == RXMODE_LINE) || (c.rxmode == RXMODE_RECORD))
+                     ? RXMODE_LINE
+                     : RXMODE_CHAR);
+  return valid;
+}
+
+void config_save(void) {
+  struct config c;
+  uint8_t p;
+
+  config_defaults(&c);
+  c.confflags = confflags;
+  c.bauddiv = OCR1A;
+  for (p = 0; p < PROFILES; p++)
+    c.tables[p] = profile_table[p];
+  c.esc_char = esc_char;
+  c.esc_guard = esc_guard;
+  c.linewidth = linewidth;
+  c.crfill = crfill;
+  c.crfill_cols = crfill_cols;
+  c.fillchar = fillchar;
+  c.resync = resync;
+  c.resync_chars = resync_chars;
+  c.resync_idle = resync_idle;
+#ifdef INCLUDE_AUTOPRINT
+  c.sched_every = sched_every;
+  c.sched_idle = sched_idle;
+#endif
+  // Nothing binary, a unit shouldn't come up talking it: record mode is
+  // saved as the line mode it frames, capture and logic not at all.
+  if ((rxmode == RXMODE_LINE) || (rxmode == RXMODE_RECORD))
+    c.rxmode = RXMODE_LINE;
+  c.rxstamp = rxstamp;
+  config_write(&c);
+}
+
+// blank every slot, so the next config_read() finds nothing.
+void config_wipe(void) {
+  uint8_t i;
+  for (i = 0; i < EEP_CONFIG_SLOTS * EEP_CONFIG_SLOT_SIZE; i++)
+    eeprom_update_byte((uint8_t *)(EEP_CONFIG_START + i), 0xff);
+  config_slot = EEP_CONFIG_SLOTS - 1;
+  config_seq = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include "profile.h"
+#include <stdint.h>
+
+// Bump this whenever struct config changes layout, and have config_read()
+// carry the old layout over. A slot with a version it doesn't know is
+// treated as blank.
+#define CONFIG_VERSION 1
+
+// Everything that "save" persists, stored as one block so it can be read in a
+// single eeprom_read_block() and checked with one CRC. The crc has to stay the
+// last member: eeprom writes go in address order, so a write torn by a reset
+// or power loss leaves a slot whose crc doesn't match and gets skipped.
+struct config {
+  uint8_t seq;     // incremented on every save, newest valid slot wins
+  uint8_t version; // CONFIG_VERSION
+  uint16_t confflags;
+  uint16_t bauddiv; // OCR1A value, see set_softuart_divisor()
+  uint8_t tables[PROFILES]; // eeprom table in each profile
+  uint8_t esc_char;   // inline command escape, see escape.c
+  uint16_t esc_guard; // ms
+  uint8_t linewidth;  // see lineout.c
+  uint8_t crfill;
+  uint8_t crfill_cols;
+  uint8_t fillchar;
+  uint8_t resync; // see shift.c
+  uint8_t resync_chars;
+  uint16_t resync_idle;
+  uint16_t sched_every; // minutes, see sched.c
+  uint16_t sched_idle;  // seconds
+  uint8_t rxmode;       // RXMODE_CHAR, _LINE or _RECORD, see rxout.c
+  uint8_t rxstamp;
+  uint16_t crc; // CRC-CCITT over everything above
+} __attribute__((packed));
+
+void config_defaults(struct config *c);
+uint8_t config_read(struct config *c);
+void config_write(struct config *c);
+uint8_t config_load(void);
+void config_save(void);
+void config_wipe(void);
+
+#endif
@@ -0,0 +1,144 @@
+/* Hayes style inline command escape.
+ *
+ * Host sends nothing for esc_guard ms, then three esc_char ('+' by default),
+ * then nothing for esc_guard ms again. The adapter answers with a framed
+ * prompt and takes the next line (up to CR or LF) as one command for
+ * cmd_execute(). Its output comes back framed as well, then the adapter
+ * goes straight back to passing data. The receiver is never turned off, so
+ * nothing coming in off the loop is lost meanwhile.
+ *
+ * If the escape chars turn out to be data (other input inside the guard
+ * time, or not enough of them), the ones held back are sent on to the loop
+ * in order, followed by the char that showed it. main() sends them as the
+ * loop has room (escape_pending(), escape_next()), before it takes anything
+ * else from the host. */
+
+#include "escape.h"
+#include "cmdline.h"
+#include "main.h"
+#include "out.h"
+#include "tick.h"
+#include "usb_serial_getstr.h"
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#define ESC_COUNT 3
+#define ESC_CMD_TIMEOUT 10000 // ms to type the command before giving up
+
+#define ESC_IDLE 0 // passing data
+#define ESC_SEEN 1 // holding back escape chars
+#define ESC_CMD 2  // escape accepted, reading a command line
+#define ESC_DATA 3 // giving back what was held, it was data
+
+uint8_t esc_char = '+';   // 0 turns the escape off
+uint16_t esc_guard = 1000; // ms of silence around the escape
+
+static uint8_t esc_state = ESC_IDLE;
+static uint8_t esc_held = 0;
+static char esc_after;        // the char that ended ESC_SEEN as data
+static uint8_t esc_after_n = 0; // 1 while it's still to go
+static uint32_t esc_last = 0; // when we last heard from the host
+static char esc_buf[CMDBUFLEN];
+static uint8_t esc_len;
+
+// give back escape chars that turned out to be data, see escape_next()
+static void escape_release(void) {
+  esc_state = esc_held ? ESC_DATA : ESC_IDLE;
+}
+
+// TRUE while there are held chars for main() to send on
+uint8_t escape_pending(void) { return esc_state == ESC_DATA; }
+
+char escape_next(void) {
+  char c = esc_char;
+
+  if (esc_held)
+    esc_held--;
+  else {
+    c = esc_after;
+    esc_after_n = 0;
+  }
+  if (!esc_held && !esc_after_n)
+    esc_state = ESC_IDLE;
+  return c;
+}
+
+static void escape_frame(uint8_t c) { usb_serial_putchar(c); }
+
+static void escape_run(void) {
+  esc_buf[esc_len] = 0;
+  escape_frame(ESC_RESP_START);
+  if (!cmd_execute(esc_buf))
+    out_str_P(PSTR("No such command.\r\n"));
+  escape_frame(ESC_RESP_END);
+  esc_state = ESC_IDLE;
+}
+
+// Called with every character from the host. Returns TRUE if the escape
+// logic took the character, so it must not go to the loop.
+uint8_t escape_filter(char c) {
+  uint32_t now = millis();
+  uint8_t quiet = (now - esc_last) >= esc_guard;
+
+  esc_last = now;
+  if (esc_char == 0)
+    return 0;
+
+  switch (esc_state) {
+  case ESC_IDLE:
+    if ((c == esc_char) && quiet) {
+      esc_state = ESC_SEEN;
+      esc_held = 1;
+      return 1;
+    }
+    return 0;
+
+  case ESC_SEEN:
+    if ((c == esc_char) && (esc_held < ESC_COUNT)) {
+      esc_held++;
+      return 1;
+    }
+    // anything else before the trailing guard time means it was data,
+    // and it goes after the ones held
+    esc_after = c;
+    esc_after_n = 1;
+    escape_release();
+    return 1;
+
+  case ESC_CMD:
+    if ((c == '\r') || (c == '\n')) {
+      if (esc_len > 0)
+        escape_run();
+    } else if (esc_len < CMDBUFLEN - 1) {
+      esc_buf[esc_len++] = c;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+// Called every trip around the main loop to handle the guard times.
+void escape_task(void) {
+  uint32_t idle;
+
+  if (esc_state == ESC_IDLE)
+    return;
+  idle = millis() - esc_last;
+
+  if (esc_state == ESC_SEEN) {
+    if (idle < esc_guard)
+      return;
+    if (esc_held < ESC_COUNT) {
+      escape_release();
+      return;
+    }
+    esc_held = 0;
+    esc_len = 0;
+    esc_state = ESC_CMD;
+    escape_frame(ESC_RESP_START);
+    out_str_P(PSTR("cmd> "));
+    escape_frame(ESC_RESP_END);
+  } else if ((esc_state == ESC_CMD) && (idle >= ESC_CMD_TIMEOUT)) {
+    esc_state = ESC_IDLE;
+  }
+}
@@ -0,0 +1,12 @@
+// Inline command escape, so single commands can be given without leaving
+// adapter mode. See escape.c.
+
+// responses to inline commands are wrapped in these, so the host can tell
+// them apart from text received off the loop
+#define ESC_RESP_START 0x02 // STX
+#define ESC_RESP_END 0x03   // ETX
+
+uint8_t escape_filter(char c);
+void escape_task(void);
+uint8_t escape_pending(void);
+char escape_next(void);
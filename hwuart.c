@@ -0,0 +1,294 @@
+#ifdef INCLUDE_HWUART
+/* Loop I/O through the 32u4's USART1 instead of the bit banged softuart.
+ *
+ * The USART does 5 to 7 bit frames with 2 stop bits (it can't send 1.5, but
+ * 2 is what the softuart sends too) and 8 bit frames with 1, and takes the
+ * timer interrupt at 3x baud out of the picture. Caveats:
+ *  - UBRR is 12 bits, so at 16MHz the slowest it can go is about 244 baud.
+ *    45.45-110 baud loops have to stay on the softuart.
+ *  - RXD1/TXD1 are PD2/PD3, not the softuart's PB6/PD7, and idle high, so
+ *    the loop interface has to be wired to them non-inverting.
+ * Selecting it turns off the softuart receiver's pin change interrupt, and
+ * logic analyzer mode and autobaud don't work until you switch back.
+ *
+ * Both directions are interrupt driven, so nothing here waits on the USART
+ * in the main loop: received frames queue up like the softuart's, and sent
+ * ones go through a queue the UDRE interrupt empties. TXCIE1 is on from the
+ * first char of a burst until the last one has left the shifter, which is
+ * how the RX interrupt knows we're sending, and when a frame format change
+ * (rxbits changed) is safe: then the TX complete interrupt makes it. */
+
+#include "hwuart.h"
+#include "conf.h"
+#include "pins.h"
+#include "softuart.h"
+#include "stats.h"
+#include "tick.h"
+#include <avr/delay.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+extern uint16_t confflags;                   // from main.c
+extern volatile unsigned char flag_tx_ready; // from softuart.c
+extern volatile uint8_t framing_error;       // from softuart.c
+extern volatile uint8_t rxbits;              // from main.c
+
+#define HWUART_TXPIN _BV(3) // PD3, TXD1
+
+uint8_t hwuart_on = 0;
+
+// same layout as the softuart's inbuf
+volatile static char hw_inbuf[SOFTUART_IN_BUF_SIZE];
+volatile static uint16_t hw_intime[SOFTUART_IN_BUF_SIZE];
+volatile static uint8_t hw_inflags[SOFTUART_IN_BUF_SIZE];
+volatile static unsigned char hw_qin = 0;
+volatile static unsigned char hw_qout = 0;
+volatile static unsigned char hw_rx_off = 0;
+volatile static char hw_txbuf[SOFTUART_TX_BUF_SIZE];
+volatile static unsigned char hw_tx_qin = 0;
+volatile static unsigned char hw_tx_qout = 0;
+// the last two chars written to UDR1, for telling our echo apart
+volatile static char hw_tx_last, hw_tx_prev;
+// the UCSR1C wanted, and whether it waits for the transmitter to finish
+volatile static uint8_t hw_ucsrc = 0;
+volatile static uint8_t hw_ucsrc_pending = 0;
+
+ISR(USART1_RX_vect) {
+  uint8_t status = UCSR1A; // has to be read before UDR1
+  char c = UDR1;
+  uint8_t flags = 0;
+  unsigned char next;
+  char sent;
+  uint8_t mask = (1 << rxbits) - 1;
+
+  if (status & _BV(DOR1))
+    stats_rx_overruns++;
+  if (status & _BV(FE1)) {
+    if (c) {
+      stats_framing_errors++;
+      flags = SOFTUART_FE;
+    } else
+      flags = SOFTUART_BREAK;
+  }
+  // main() watches this for the start and end of a break
+  framing_error = (flags == SOFTUART_BREAK);
+  // The frame in the shifter is the last one written, or the one before that
+  // if the next is already waiting in UDR1.
+  if (UCSR1B & _BV(TXCIE1)) {
+    sent = (status & _BV(UDRE1)) ? hw_tx_last : hw_tx_prev;
+    sent = (sent & mask) | (c & ~mask); // only rxbits to compare
+    if (!flags && (sent == c))
+      flags = SOFTUART_ECHO;
+    else {
+      flags |= SOFTUART_COLLISION;
+      if (confflags & CONF_HALFDUPLEX)
+        stats_collisions++;
+    }
+  }
+  if (hw_rx_off)
+    return;
+
+  next = hw_qin + 1;
+  if (next >= SOFTUART_IN_BUF_SIZE)
+    next = 0;
+  if (next == hw_qout) {
+    stats_rx_overruns++;
+    return;
+  }
+  hw_inbuf[hw_qin] = c & mask;
+  hw_intime[hw_qin] = millis();
+  hw_inflags[hw_qin] = flags;
+  hw_qin = next;
+}
+
+// UDR1 is free again: the next queued char, unless the frame format has to
+// change first, which waits for the TX complete interrupt below.
+ISR(USART1_UDRE_vect) {
+  char c;
+
+  if (hw_ucsrc_pending || (hw_tx_qout == hw_tx_qin)) {
+    UCSR1B &= ~_BV(UDRIE1);
+    if (hw_tx_qout == hw_tx_qin)
+      flag_tx_ready = 0;
+    return;
+  }
+  c = hw_txbuf[hw_tx_qout];
+  if (++hw_tx_qout >= SOFTUART_TX_BUF_SIZE)
+    hw_tx_qout = 0;
+  // TXC1 clears by writing a one; the error flags want zeros
+  UCSR1A = (UCSR1A & (_BV(U2X1) | _BV(MPCM1))) | _BV(TXC1);
+  UCSR1B |= _BV(TXCIE1);
+  hw_tx_prev = hw_tx_last;
+  hw_tx_last = c;
+  UDR1 = c;
+}
+
+// the last frame is out and UDR1 is empty
+ISR(USART1_TX_vect) {
+  UCSR1B &= ~_BV(TXCIE1);
+  if (hw_ucsrc_pending) {
+    UCSR1C = hw_ucsrc;
+    hw_ucsrc_pending = 0;
+  }
+  if (hw_tx_qout != hw_tx_qin)
+    UCSR1B |= _BV(UDRIE1);
+}
+
+// rxbits wide, 8N1, or 2 stop bits for anything narrower (the softuart does
+// 1.5 for 5 and 6). Changed straight away if nothing is being sent, else by
+// the TX complete interrupt.
+static void hw_frame(void) {
+  uint8_t want;
+
+  want = (rxbits - 5) << UCSZ10;
+  if (rxbits < 8)
+    want |= _BV(USBS1);
+  if (want == hw_ucsrc)
+    return;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    hw_ucsrc = want;
+    if (UCSR1B & _BV(TXCIE1))
+      hw_ucsrc_pending = 1;
+    else
+      UCSR1C = want;
+  }
+}
+
+// wait until everything queued has been sent
+static void hw_tx_drain(void) {
+  while (UCSR1B & (_BV(UDRIE1) | _BV(TXCIE1)))
+    ;
+}
+
+// The softuart divisor counts F_CPU/64 at 3x baud, UBRR counts F_CPU/16 at
+// 1x, so UBRR = 12 * divisor - 1. Falls back to the softuart if the speed is
+// too slow for the USART. Returns 1 if the USART is still in use.
+uint8_t hwuart_set_divisor(uint16_t divisor) {
+  if ((divisor == 0) || (divisor > (4096 / 12))) {
+    hwuart_select(0);
+    return 0;
+  }
+  if (hwuart_on)
+    hw_tx_drain(); // not mid-frame
+  UBRR1 = 12 * divisor - 1;
+  return 1;
+}
+
+// Switch the loop between the USART (on = 1) and the softuart. Returns 1 if
+// the USART ended up selected, and keeps CONF_HWUART in step.
+uint8_t hwuart_select(uint8_t on) {
+  if (hwuart_on)
+    hw_tx_drain(); // let the last char go out first
+  else
+    while (flag_tx_ready)
+      ;
+
+  if (on && !hwuart_on) {
+    if (OCR1A > (4096 / 12)) {
+      confflags &= ~CONF_HWUART;
+      return 0;
+    }
+    PCMSK0 &= ~_BV(SOFTUART_RXBIT); // softuart receiver off
+    softuart_flush_input_buffer();
+    hwuart_on = 1;
+    UCSR1B = 0;
+    UCSR1A = 0;
+    UCSR1C = 0;
+    hw_ucsrc = 0;
+    hw_ucsrc_pending = 0;
+    hw_tx_qin = hw_tx_qout = 0;
+    hwuart_set_divisor(OCR1A);
+    hw_frame();
+    UCSR1B = _BV(RXCIE1) | _BV(RXEN1) | _BV(TXEN1);
+  } else if (!on && hwuart_on) {
+    UCSR1B = 0;
+    hwuart_on = 0;
+    PCMSK0 |= _BV(SOFTUART_RXBIT);
+  }
+  if (hwuart_on)
+    confflags |= CONF_HWUART;
+  else
+    confflags &= ~CONF_HWUART;
+  return hwuart_on;
+}
+
+// How many more chars hwuart_putchar() will take without waiting.
+unsigned char hwuart_tx_free(void) {
+  unsigned char used;
+
+  used = hw_tx_qin - hw_tx_qout;
+  if (used >= SOFTUART_TX_BUF_SIZE) // wrapped
+    used += SOFTUART_TX_BUF_SIZE;
+  return (SOFTUART_TX_BUF_SIZE - 1 - used);
+}
+
+void hwuart_putchar(char c) {
+  unsigned char next;
+
+  while (hwuart_tx_free() == 0)
+    ; // the UDRE interrupt makes room
+  hw_frame();
+  stats.tx_chars++;
+  next = hw_tx_qin + 1;
+  if (next >= SOFTUART_TX_BUF_SIZE)
+    next = 0;
+  hw_txbuf[hw_tx_qin] = c;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    hw_tx_qin = next;
+    flag_tx_ready = 1;
+    if (!hw_ucsrc_pending)
+      UCSR1B |= _BV(UDRIE1);
+  }
+}
+
+char hwuart_getframe(uint16_t *time, uint8_t *flags) {
+  char ch;
+
+  if (hw_qout == hw_qin)
+    return (0);
+  ch = hw_inbuf[hw_qout];
+  *time = hw_intime[hw_qout];
+  *flags = hw_inflags[hw_qout];
+  if (++hw_qout >= SOFTUART_IN_BUF_SIZE)
+    hw_qout = 0;
+  return (ch);
+}
+
+uint8_t hwuart_peekflags(void) {
+  if (hw_qout == hw_qin)
+    return (0);
+  return (hw_inflags[hw_qout]);
+}
+
+char hwuart_getchar(void) {
+  uint16_t time;
+  uint8_t flags;
+
+  return hwuart_getframe(&time, &flags);
+}
+
+unsigned char hwuart_kbhit(void) {
+  hw_frame(); // in case the width changed, never waits
+  return (hw_qin != hw_qout);
+}
+
+void hwuart_flush_input_buffer(void) {
+  hw_qin = 0;
+  hw_qout = 0;
+}
+
+void hwuart_rx(uint8_t on) { hw_rx_off = !on; }
+
+// hold TXD1 low (space) for 500ms, like send_break() does on the softuart
+void hwuart_send_break(void) {
+  hw_tx_drain();
+  hw_rx_off = 1;
+  PORTD &= ~HWUART_TXPIN;
+  DDRD |= HWUART_TXPIN;
+  UCSR1B &= ~_BV(TXEN1);
+  _delay_ms(500);
+  UCSR1B |= _BV(TXEN1);
+  hw_rx_off = 0;
+}
+#endif
@@ -0,0 +1,14 @@
+// Hardware USART1 backend for the loop, behind the softuart_* API.
+extern uint8_t hwuart_on;
+
+uint8_t hwuart_select(uint8_t on);
+uint8_t hwuart_set_divisor(uint16_t divisor);
+unsigned char hwuart_tx_free(void);
+void hwuart_putchar(char c);
+char hwuart_getchar(void);
+char hwuart_getframe(uint16_t *time, uint8_t *flags);
+uint8_t hwuart_peekflags(void);
+unsigned char hwuart_kbhit(void);
+void hwuart_flush_input_buffer(void);
+void hwuart_rx(uint8_t on);
+void hwuart_send_break(void);
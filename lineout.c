@@ -0,0 +1,233 @@
+/* Line handling for text going to the loop in translate mode.
+ *
+ * column counts what actually printed: chars with no Baudot equivalent and
+ * the LTRS/FIGS shifts tty_putchar() adds don't move the carriage. With
+ * autocr a CR LF goes out once the carriage reaches linewidth. With
+ * wordwrap as well, printing chars are held until the end of the word, so
+ * the line can be broken at the space before it instead of in the middle.
+ * A word is let go after LINEOUT_WORD_IDLE ms anyway, for people typing.
+ *
+ * Every CR is followed by fill, so the carriage is back before the next
+ * printing char: crfill, plus one more for every crfill_cols columns it had
+ * to travel. The fill is LTRS (doesn't print, and leaves the machine in the
+ * shift we track anyway; NUL with a table that has no shifts), NUL, or
+ * just that many char times of idle line.
+ * The LF of a line break goes out straight after the CR, the paper can
+ * move meanwhile.
+ *
+ * None of this waits: fill is queued as the TX queue has room, and while
+ * it's under way the main loop doesn't take more from the host
+ * (lineout_ready()). A word that was being sent when a fill started, and the
+ * char that ended it, are finished off from lineout_task(). */
+
+#include "lineout.h"
+#include "baudot.h"
+#include "conf.h"
+#include "profile.h"
+#include "softuart.h"
+#include "tick.h"
+#include <avr/io.h>
+#include <ctype.h>
+
+extern uint16_t confflags;                   // from main.c
+extern volatile uint8_t txbits;              // from main.c
+extern uint8_t baudot_shift_send;            // from baudot.c
+extern volatile unsigned char flag_tx_ready; // from softuart.c
+
+uint8_t column = 0;
+uint8_t linewidth = 68;
+uint8_t crfill = 0;
+uint8_t crfill_cols = 0;
+uint8_t fillchar = FILL_LTRS;
+
+static char word[LINEOUT_WORDLEN];
+static uint8_t wordlen = 0;
+static uint8_t wordpos = 0;      // how much of it has been sent
+static uint8_t word_sending = 0; // word_flush() isn't done with it yet
+static uint8_t word_end = 0;     // and after that the word is over
+static uint8_t word_started = 0; // part of this word already went out
+static uint32_t word_ms;
+
+static char held; // the char that ended a word still being sent
+static uint8_t held_on = 0;
+static char next; // a char that came in behind a fill, see lineout_putchar()
+static uint8_t next_on = 0;
+
+static uint8_t fill_left = 0; // fill chars still to queue
+static uint8_t gap_chars = 0; // FILL_GAP: char times to wait once CR is out
+static uint8_t gap_on = 0;
+static uint32_t gap_end;
+
+// one frame on the loop, in ms
+static uint16_t char_ms(void) {
+  return (uint32_t)txbits * 3 * (OCR1A + 1) / (F_CPU / 64 / 1000);
+}
+
+static void fill_start(uint8_t travelled) {
+  uint16_t n = crfill;
+
+  if (crfill_cols)
+    n += travelled / crfill_cols;
+  if (n > 255)
+    n = 255;
+  if (fillchar == FILL_GAP) {
+    gap_chars = n;
+  } else {
+    fill_left = n;
+    if (n && (fillchar == FILL_LTRS))
+      baudot_shift_send = LTRS;
+  }
+}
+
+// Queue as much fill as fits and time the gap. Returns 1 while a fill is
+// still under way.
+static uint8_t fill_busy(void) {
+  while (fill_left && softuart_tx_free()) {
+    tty_putchar_raw((fillchar == FILL_NUL) ? 0 : profile_code(LTRS));
+    fill_left--;
+  }
+  if (gap_chars && !flag_tx_ready) { // CR and LF are out, start the clock
+    gap_end = millis() + (uint32_t)gap_chars * char_ms();
+    gap_chars = 0;
+    gap_on = 1;
+  }
+  if (gap_on && ((int32_t)(millis() - gap_end) >= 0))
+    gap_on = 0;
+  return (fill_left || gap_chars || gap_on);
+}
+
+static void put_one(char c);
+static void lineout_take(char c);
+
+static void newline(void) {
+  put_one('\r');
+  put_one('\n');
+}
+
+static void put_one(char c) {
+  uint8_t travelled;
+
+  // a space that would land past the end of the line is where we break
+  if ((c == ' ') && (confflags & (CONF_AUTOCR | CONF_WORDWRAP)) &&
+      (column >= linewidth)) {
+    newline();
+    return;
+  }
+
+  if (!tty_putchar(c))
+    return;
+  if (c == '\r') {
+    travelled = column;
+    column = 0;
+    fill_start(travelled);
+  } else if (isprint(c)) {
+    column++;
+    if ((confflags & CONF_AUTOCR) && !(confflags & CONF_WORDWRAP) &&
+        (column >= linewidth))
+      newline();
+  }
+}
+
+// Send the held word, on a fresh line if it doesn't fit on this one. A word
+// longer than a whole line just gets broken at the margin, and so does the
+// rest of one that had to go out early. Stops if a line break starts a
+// fill; lineout_run() calls it again.
+static void word_flush(void) {
+  if (!word_started && (wordpos == 0) && column &&
+      (column + wordlen > linewidth))
+    newline();
+  while (wordpos < wordlen) {
+    if (column >= linewidth)
+      newline();
+    if (fill_busy())
+      return;
+    put_one(word[wordpos++]);
+  }
+  wordlen = 0;
+  wordpos = 0;
+  word_sending = 0;
+  word_started = !word_end;
+}
+
+static void word_send(uint8_t end) {
+  word_sending = 1;
+  word_end = end;
+  word_flush();
+}
+
+// Carry on with whatever a fill held up. Returns 1 if still not done.
+static uint8_t lineout_run(void) {
+  if (fill_busy())
+    return 1;
+  if (word_sending) {
+    word_flush();
+    if (word_sending)
+      return 1;
+  }
+  if (held_on) {
+    held_on = 0;
+    put_one(held);
+    if (fill_busy())
+      return 1;
+  }
+  if (next_on) {
+    next_on = 0;
+    lineout_take(next);
+    return lineout_run();
+  }
+  return 0;
+}
+
+// TRUE when the next char can go out without waiting on a fill.
+uint8_t lineout_ready(void) { return !lineout_run(); }
+
+static void lineout_take(char c) {
+  if ((confflags & CONF_WORDWRAP) && isgraph(c)) {
+    word[wordlen++] = c;
+    word_ms = millis();
+    if (wordlen >= LINEOUT_WORDLEN)
+      word_send(0);
+    return;
+  }
+  if (wordlen) {
+    held = c;
+    held_on = 1;
+    word_send(1);
+    lineout_run();
+    return;
+  }
+  word_started = 0;
+  put_one(c);
+}
+
+void lineout_putchar(char c) {
+  // The LF of a CR LF pair comes in right behind the CR and its fill; keep
+  // it for lineout_run(). Only callers that don't check lineout_ready()
+  // (held escape chars) ever have to wait here.
+  if (lineout_run()) {
+    if (!next_on) {
+      next = c;
+      next_on = 1;
+      return;
+    }
+    while (lineout_run())
+      ;
+  }
+  lineout_take(c);
+}
+
+// TRUE once everything taken so far is in the TX queue. Lets a held word go
+// now rather than wait for the rest of it.
+uint8_t lineout_idle(void) {
+  if (!word_sending && wordlen)
+    word_send(0);
+  return !lineout_run() && !wordlen;
+}
+
+// let a word go if the host has stopped in the middle of it
+void lineout_task(void) {
+  if (!word_sending && wordlen &&
+      (millis() - word_ms >= LINEOUT_WORD_IDLE))
+    word_send(0);
+  lineout_run();
+}
@@ -0,0 +1,23 @@
+// Host to loop text in translate mode: column tracking, auto-CR, word wrap
+// and fill after CR. See lineout.c.
+
+#define LINEOUT_WORDLEN 16    // longer words are sent as they come
+#define LINEOUT_WORD_IDLE 500 // ms before a half typed word goes out anyway
+#define LINEOUT_MAXWIDTH 132
+#define LINEOUT_MAXFILL 8
+
+// what goes out after a CR
+#define FILL_LTRS 0
+#define FILL_NUL 1
+#define FILL_GAP 2 // nothing, just wait that many char times
+
+extern uint8_t column;      // where the carriage is
+extern uint8_t linewidth;   // columns before auto-CR
+extern uint8_t crfill;      // fill after each CR
+extern uint8_t crfill_cols; // one more per this many columns, 0 = off
+extern uint8_t fillchar;    // FILL_
+
+void lineout_putchar(char c);
+uint8_t lineout_ready(void);
+uint8_t lineout_idle(void);
+void lineout_task(void);
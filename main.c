@@ -1,55 +1,73 @@
 #include "main.h"
 #include "baudot.h"
+#include "cmdline.h"
 #include "conf.h"
+#include "config.h"
+#include "escape.h"
+#include "lineout.h"
 #include "lufa_serial.h"
+#include "out.h"
 #include "pins.h"
+#include "profile.h"
+#include "rxout.h"
+#include "shift.h"
 #include "softuart.h"
+#include "spool.h"
+#include "stats.h"
+#include "tick.h"
 #include "usb_serial_getstr.h"
 #include <avr/eeprom.h>
+#include <avr/sleep.h>
 #include <ctype.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef INCLUDE_AUTOPRINT
 #include "autoprint.h"
+#include "sched.h"
+#endif
+#ifdef INCLUDE_HWUART
+#include "hwuart.h"
+#endif
+#ifdef INCLUDE_UTF8
+#include "utf8.h"
 #endif
-
-#define EEWRITE
 
 // These are just tested values that will override specific entered values. You
 // can set any value at all, and if it's not in this list, it will just use
 // F_CPU/64/3/X.
-#define NSPEEDS 5
-const uint16_t speeds[5][2] = {
+const uint16_t speeds[NSPEEDS][2] = {
     {45, 1833}, {50, 1667}, {56, 1464}, {75, 1123}, {110, 757}};
 
+// only take a char from the host with this much room in the TX queue, so
+// one char plus its shift, CR LF and fill normally won't have to wait
+#define MAIN_TX_RESERVE 8
+
 #define ASCII_FIGS_CHAR '{'
 #define ASCII_LTRS_CHAR '}'
 
 // function protos
-void help(void);
-void commandline(void);
-void ee_dump(void);
-void ee_wipe(void);
-void usbserial_tasks(void);
 int tty_putchar(char c);
-void softuart_status(void);
-uint16_t divisor_to_baud(uint16_t);
-uint16_t baud_to_divisor(uint16_t);
-void set_softuart_divisor(uint16_t);
-void ee_write(char *);
+void boot_task(void);
+uint8_t usb_host_ready(void);
 
 // globals, clean this up.
 extern volatile unsigned char flag_tx_ready;
 extern volatile uint8_t framing_error;
 extern volatile uint8_t baudot_shift_send;
+int8_t get_rx_pin_status(void); // from softuart.c
 volatile uint8_t host_break = 0;
-uint8_t tableselector = 0; // which ascii/baudot translation table we're using
-
-uint16_t baudtmp;
-uint8_t confflags = 0;
-uint8_t saved;
-static FILE USBSerialStream;
+volatile uint8_t usb_suspended = 0; // set by the USB suspend/wakeup events
+static uint8_t spooling = 0;        // the loop is down, see spool.c
+
+// boot is split so USB can enumerate before the (possibly slow) eeprom work
+#define BOOT_LOAD 0   // read the saved config
+#define BOOT_TABLES 1 // no settings, writing the default table if it's blank
+#define BOOT_DONE 2
+uint8_t boot_state = BOOT_LOAD;
+uint8_t boot_step = 0;
+uint32_t boot_usb_ms = 0;    // when the host configured us
+uint32_t boot_config_ms = 0; // when settings and tables were ready
+uint16_t confflags = 0;
 volatile uint8_t txbits = 8, rxbits = 5;
 
 // LUFA CDC Class driver interface configuration and state information. stolen
@@ -83,8 +101,22 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface = {
 #define RELAYS_ENABLED 1
 #define RELAYS_FORCED_ON 2
 
+// Suspend and resume can't blink for seconds the way relays_off() and
+// relays_on() do: that runs from the main loop with USB unserviced. They
+// switch the first relay straight away and relay_task() the second one
+// RELAY_SETTLE_MS later, the same order and about the same gap.
+#define RELAY_SETTLE_MS 3000
+#define RELAY_NEXT_NONE 0
+#define RELAY_NEXT_LOOP_OFF 1 // the motor is off, the loop follows
+#define RELAY_NEXT_AC_ON 2    // the loop is on, the motor follows
+static uint8_t relay_next = RELAY_NEXT_NONE;
+static uint32_t relay_next_ms;
+static int relay_resume = RELAYS_OFF; // relay_state to restore at wakeup
 
 void relays_off(int *relay_state) {
+    if (relay_next == RELAY_NEXT_AC_ON) // resuming, only the loop is on yet
+      current_loop_off();
+    relay_next = RELAY_NEXT_NONE;
     if (*relay_state != RELAYS_OFF) {
         ac_off();
         for (int i = 0; i < 6; i++) {
@@ -101,6 +133,7 @@ void relays_off(int *relay_state) {
 }
 
 void relays_on(int *relay_state) {
+    relay_next = RELAY_NEXT_NONE;
     if (*relay_state != RELAYS_ENABLED) {
         current_loop_on();
         for (int i = 0; i < 8; i++) {
@@ -116,17 +149,187 @@ void relays_on(int *relay_state) {
     }
 }
 
-int main(void) {
-  uint8_t column = 0, framing_error_last;
-  char char_from_usb;
-  char char_from_tty;
-  uint16_t configured;
+static void relays_suspend(int *relay_state) {
+  relay_resume = *relay_state;
+  if (*relay_state != RELAYS_OFF) {
+    ac_off();
+    relay_next = RELAY_NEXT_LOOP_OFF;
+    relay_next_ms = millis();
+    *relay_state = RELAYS_OFF;
+  }
+}
+
+static void relays_resume(void) {
+  if (relay_resume != RELAYS_OFF) {
+    current_loop_on();
+    relay_next = RELAY_NEXT_AC_ON;
+    relay_next_ms = millis(); // still on if woken within RELAY_SETTLE_MS
+  }
+}
+
+static void relay_task(int *relay_state) {
+  if ((relay_next == RELAY_NEXT_NONE) ||
+      (millis() - relay_next_ms < RELAY_SETTLE_MS))
+    return;
+  if (relay_next == RELAY_NEXT_LOOP_OFF)
+    current_loop_off();
+  else {
+    ac_on();
+    *relay_state = relay_resume;
+  }
+  relay_next = RELAY_NEXT_NONE;
+}
+
+// TRUE while the loop can't print what the host sends: the relays are off
+// on a unit wired for them, or the line has been at space SPOOL_OPEN_MS. It's
+// closed again after SPOOL_SETTLE_MS of mark. See spool.c.
+static uint8_t loop_down(int relay_state) {
+  static uint8_t open = 0, space = 0;
+  static uint32_t since; // when the line last changed
+  uint8_t s;
+
+  if (confflags & CONF_HWUART)
+    s = framing_error; // no pin to look at, but breaks are still seen
+  else
+    s = !get_rx_pin_status();
+  if (s != space) {
+    space = s;
+    since = millis();
+  }
+  if (millis() - since >= (space ? SPOOL_OPEN_MS : SPOOL_SETTLE_MS))
+    open = space;
+  return open || (relays_enabled() && (relay_state == RELAYS_OFF));
+}
+
+// Doze until the next interrupt (the 1ms tick, USB, an RX edge or the TX
+// timer) unless something from the loop is already waiting.
+static void idle_sleep(void) {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  if (!softuart_kbhit()) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+}
+
+// Can host_to_loop() take a char without waiting? Needs room in the TX
+// queue, any fill after a CR out of the way, and whatever the last char
+// started (a profile switch, a UTF-8 transliteration) finished.
+static uint8_t host_to_loop_ready(void) {
+  if (profile_pending())
+    return 0;
+#ifdef INCLUDE_UTF8
+  if (utf8_pending())
+    return 0;
+#endif
+#ifdef INCLUDE_AUTOPRINT
+  if (sched_pending())
+    return 0;
+#endif
+  return (softuart_tx_free() >= MAIN_TX_RESERVE) &&
+         (!(confflags & CONF_TRANSLATE) || lineout_ready());
+}
+
+#ifdef INCLUDE_UTF8
+// What a UTF-8 sequence came out as goes to the loop like chars from the
+// host would, as there's room, and before the next one is taken.
+static void utf8_drain(void) {
+  while (utf8_pending() && (softuart_tx_free() >= MAIN_TX_RESERVE) &&
+         lineout_ready())
+    lineout_putchar(utf8_next());
+}
+#endif
+
+static void host_to_loop_now(char c);
+
+// So does what was spooled while the loop was down, before anything newer.
+static void spool_drain(void) {
+  while (spool_len() && host_to_loop_ready())
+    host_to_loop_now(spool_next());
+}
+
+// Can main() take a char from the host? Spooling, while there's room, or
+// always with the relays off so a DC2 still gets through.
+static uint8_t host_take_ready(int relay_state) {
+  if (spooling || spool_len())
+    return !spool_full() || (relays_enabled() && (relay_state == RELAYS_OFF));
+  return host_to_loop_ready();
+}
+
+// Escape chars that turned out to be data, see escape.c, go on like host
+// chars, as there's room, and before main() takes any more.
+static void escape_drain(int relay_state) {
+  while (escape_pending() && host_take_ready(relay_state))
+    host_to_loop(escape_next());
+}
+
+#ifdef INCLUDE_AUTOPRINT
+// A scheduled message goes the same way, see sched.c.
+static void sched_drain(void) {
+  while (sched_pending() && (softuart_tx_free() >= MAIN_TX_RESERVE) &&
+         lineout_ready())
+    lineout_putchar(sched_next());
+}
+#endif
+
+// Send one character from the host toward the TTY loop, or to the spool
+// while the loop is down or the spool still has some to go before it.
+void host_to_loop(char c) {
+  if (spooling || spool_len())
+    spool_put(c);
+  else
+    host_to_loop_now(c);
+}
 
-  eeprom_read_block(&configured, (const void *)EEP_CONFIGURED_LOCATION,
-                    (size_t)EEP_CONFIGURED_SIZE);
+// Send it now, translating and doing the CR/LF handling per confflags.
+static void host_to_loop_now(char c) {
+  if (confflags & CONF_TRANSLATE) {
+    if (profile_filter(c))
+      return;
+#ifdef INCLUDE_UTF8
+    if ((confflags & CONF_UTF8) && utf8_take(c)) {
+      utf8_drain();
+      return;
+    }
+#endif
+    if ((c == ASCII_FIGS_CHAR) && profile_code(FIGS)) {
+      softuart_putchar(profile_code(FIGS));
+      baudot_shift_send = FIGS;
+      shift_sent(profile_code(FIGS));
+      return;
+    }
+    if ((c == ASCII_LTRS_CHAR) && profile_code(LTRS)) {
+      softuart_putchar(profile_code(LTRS));
+      baudot_shift_send = LTRS;
+      shift_sent(profile_code(LTRS));
+      return;
+    }
+    // ASCII CR or LF ---> tty CR _and_ LF
+    if ((confflags & CONF_CRLF) && ((c == 0x0d) || (c == 0x0a))) {
+      lineout_putchar('\r');
+      lineout_putchar('\n');
+    } else
+      lineout_putchar(c);
+  } else {
+    // we are in transparent mode, just pass the character through
+    // unchanged.
+    if (confflags & CONF_8BIT)
+      tty_putchar_raw(c);
+    else // not sure if i need to actually mask here, but let's be safe
+      tty_putchar_raw(c & 0x1F);
+  }
+}
+
+int main(void) {
+  uint8_t framing_error_last;
+  int16_t char_from_usb;
 
   SetupHardware(); // USB interface setup
   wdt_reset();
+  tick_init();
   softuart_init();
   // setup pins for softuart, led, etc.
   SOFTUART_TXDDR |=
@@ -140,21 +343,8 @@ int main(void) {
 
   GlobalInterruptEnable();
 
-  // Check for magic number in eeprom to see if unit has valid configuration.
-  if (configured != EEP_CONFIGURED_MAGIC)
-    ee_wipe(); // Make sure there are valid config settings, baud, and tables
-
-  // Read saved config settings from eeprom.
-  eeprom_read_block(&confflags, (const void *)EEP_CONFFLAGS_LOCATION,
-                    (size_t)EEP_CONFFLAGS_SIZE);
-  eeprom_read_block(&baudtmp, (const void *)EEP_BAUDDIV_LOCATION,
-                    (size_t)EEP_BAUDDIV_SIZE);
-  set_softuart_divisor(baudtmp);
-  tableselector = eeprom_read_byte(EEP_TABLE_SELECT_LOCATION);
-
-  CDC_Device_CreateStream(&VirtualSerial_CDC_Interface, &USBSerialStream);
-  stdin = stdout = &USBSerialStream; // so printf, etc go to usb serial.
-  sei();
+  // Saved settings are read by boot_task() from inside the loop, so USB
+  // enumeration doesn't wait on the eeprom.
 
   int relay_state = RELAYS_OFF;
   int loopnum = 0;
@@ -165,21 +355,60 @@ int main(void) {
   while (1) {
     //loopnum += 1;
 
-    // Have we been told to go into config mode?
-    if (!(PINF & (1 << 4))) {
+    // Until the config is loaded (or a blank unit has its default table),
+    // only keep USB serviced, don't pass any traffic.
+    if (boot_state != BOOT_DONE) {
+      boot_task();
+      usbserial_tasks();
+      continue;
+    }
+
+    // The host suspended the bus (PC asleep, or the hub idle overnight):
+    // drop the loop and the lights and sleep until it wakes us up again,
+    // then put the relays back the way they were. Once the relays are done
+    // the tick stops too, so only USB wakeup or the loop wakes us.
+    if (usb_suspended) {
+      relays_suspend(&relay_state);
+      tx_led_off();
+      rx_led_off();
+      while (usb_suspended) {
+        relay_task(&relay_state);
+        if (relay_next == RELAY_NEXT_NONE) {
+          tick_stop();
+          idle_sleep();
+          tick_start();
+        } else
+          idle_sleep();
+      }
+      relays_resume();
+      continue;
+    }
+    relay_task(&relay_state);
+
+    // Have we been told to go into config mode? Ignore the button until the
+    // host has the port open, otherwise we'd sit in commandline() talking to
+    // nobody and look hung.
+    if (!(PINF & (1 << 4)) && usb_host_ready()) {
       softuart_turn_rx_off();
       commandline();
       softuart_turn_rx_on();
       column = 0;
     }
 
-    // update rxbits/txbits for softuart between chars
+    // update rxbits/txbits for softuart between chars. Translating, the
+    // table says how wide the codes are. Up to 6 bits get 1.5 stop bits,
+    // 7 gets 2.
     if (confflags & CONF_8BIT) {
       rxbits = 8;
       txbits = 10; // i guess?
     } else {
-      rxbits = 5;
-      txbits = 8;
+      rxbits = (confflags & CONF_TRANSLATE) ? profile_width[profile_cur] : 5;
+      txbits = (rxbits < 7) ? rxbits + 3 : 10;
+    }
+
+    if ((framing_error == 1) && (framing_error_last == 0)) {
+      stats.breaks++;
+      shift_break();
     }
 
     // check for end of break condition
@@ -187,66 +416,47 @@ int main(void) {
       if (confflags & CONF_SHOWBREAK)
 #ifdef INCLUDE_AUTOPRINT
         if (confflags & CONF_AUTOPRINT) {
-          printf_P(PSTR("[Autoprinting... "));
+          out_str_P(PSTR("[Autoprinting... "));
           do_autoprint();
-          printf_P(PSTR("done.]\r\n"));
+          out_str_P(PSTR("done.]\r\n"));
         } else
 #endif
-          printf("[BREAK]\r\n");
+          out_str_P(PSTR("[BREAK]\r\n"));
     framing_error_last = framing_error;
 
     // check if USB host is trying to send a break.
     if (host_break == 1) {
       send_break(); // actually break the loop for 500ms
+      shift_break();
       host_break = 0;
     }
 
+    // With the loop down, host text is held until it's back (spool.c), and
+    // it all goes out through the spool until that's empty, to keep order.
+    if ((confflags & CONF_SPOOL) && loop_down(relay_state)) {
+      if (!spooling)
+        stats.outages++;
+      spooling = 1;
+    } else if (spooling) {
+      spooling = 0;
+      shift_forget(); // the machine may have been reset, or typed on
+    }
+    if (!spooling)
+      spool_drain();
+
     // Do we have a character received from USB, to send to the TTY loop?
     // Only pick a char from USB host if we're ready to process it.
     // if not, it's the host's job to queue or block or whatever.
-    if (flag_tx_ready == 0) {
+    stats_host_pending();
+    escape_drain(relay_state);
+    if (!escape_pending() && host_take_ready(relay_state)) {
       char_from_usb = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
-      if (char_from_usb != 0xFF) { // CDC_Device_ReceiveByte() returns 0xFF when
-                                   // there's no char available.
-        if (confflags & CONF_TRANSLATE) {
-          if (char_from_usb == ASCII_FIGS_CHAR) {
-            softuart_putchar(FIGS);
-            baudot_shift_send = FIGS;
-            continue;
-          }
-          if (char_from_usb == ASCII_LTRS_CHAR) {
-            softuart_putchar(LTRS);
-            baudot_shift_send = LTRS;
-            continue;
-          }
-          // ASCII CR or LF ---> tty CR _and_ LF
-          if ((confflags & CONF_CRLF) &&
-              ((char_from_usb == 0x0d) || (char_from_usb == 0x0a))) {
-            tty_putchar('\r');
-            tty_putchar('\n');
-          } else
-            tty_putchar(char_from_usb);
-
-          // auto-CRLF on send. only works once we've seen the first newline
-          if ((confflags & CONF_AUTOCR)) {
-            if (isprint(char_from_usb))
-              column++;
-            if ((char_from_usb == 0x0d) || (char_from_usb == 0x0a))
-              column = 0;
-            if (column >= 68) { // prob should be a config option
-              tty_putchar('\r');
-              tty_putchar('\n');
-              column = 0;
-            }
-          }
-        } else {
-          // we are in transparent mode, just pass the character through
-          // unchanged.
-          if (confflags & CONF_8BIT)
-            tty_putchar_raw(char_from_usb);
-          else // not sure if i need to actually mask here, but let's be safe
-            tty_putchar_raw(char_from_usb & 0x1F);
-        }
+      if (char_from_usb >= 0) { // CDC_Device_ReceiveByte() returns -1 when
+                                // there's no char available; 0xFF is a
+                                // real byte in 8 bit mode.
+        stats_host_taken();
+        if (!escape_filter(char_from_usb))
+          host_to_loop(char_from_usb);
       }
 
 #ifdef RELAY_USB_CONTROL
@@ -274,315 +484,39 @@ int main(void) {
 #endif
     }
 
-    // Now the other side: do we have a character from the TTY loop ready
-    // to send to USB? If so, process it.
-
-    if (softuart_kbhit()) {
-      if (confflags & CONF_TRANSLATE)
-        char_from_tty = baudot_to_ascii(softuart_getchar());
-      else if (confflags & CONF_8BIT)
-        char_from_tty = softuart_getchar();
-      else
-        char_from_tty =
-            softuart_getchar() & 0x1F; // masking may not be necessary
-      if (char_from_tty != 0)
-        usb_serial_putchar(char_from_tty);
-    }
+    // Now the other side, from the TTY loop to USB.
+    loop_to_host();
 
-    // Process USB events.
-    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
-    USB_USBTask();
-  }
-}
-
-void commandline(void) {
-  uint8_t n, valid;
-  char *res = NULL;
-  static char buf[CMDBUFLEN]; // command line input buffer
-
-  softuart_turn_rx_off();
-  help();
-
-  while (1) {
-    valid = 0;
-    printf("cmd> ");
-    memset(buf, 0, CMDBUFLEN);
-
-    n = usb_serial_getstr(buf, CMDBUFLEN - 1);
-    printf_P(PSTR("\r\n"));
-    if (n == 0)
-      continue;
-    res = strtok(buf, " ");
-
-    if (strncmp(res, "help", 5) == 0) {
-      valid = 1;
-      help();
-    }
-
-    if (strncmp(res, "exit", 5) == 0) {
-      valid = 1;
-      printf_P(PSTR("Returning to adapter mode.\r\n"));
-      softuart_turn_rx_on();
-      return;
-    }
-
-    // save/load/show settings
-    if (strncmp(res, "save", 5) == 0) {
-      valid = 1;
-      eeprom_write_block(&confflags, (void *)EEP_CONFFLAGS_LOCATION,
-                         (size_t)EEP_CONFFLAGS_SIZE);
-      baudtmp = OCR1A;
-      eeprom_write_block(&baudtmp, (void *)EEP_BAUDDIV_LOCATION,
-                         (size_t)EEP_BAUDDIV_SIZE);
-      eeprom_write_byte(EEP_TABLE_SELECT_LOCATION, tableselector);
-      printf_P(PSTR("Settings saved.\r\n"));
-    }
-
-    if (strncmp(res, "load", 5) == 0) {
-      valid = 1;
-      eeprom_read_block(&confflags, (const void *)EEP_CONFFLAGS_LOCATION,
-                        (size_t)EEP_CONFFLAGS_SIZE);
-      eeprom_read_block(&baudtmp, (const void *)EEP_BAUDDIV_LOCATION,
-                        (size_t)EEP_BAUDDIV_SIZE);
-      set_softuart_divisor(baudtmp);
-      tableselector = eeprom_read_byte(EEP_TABLE_SELECT_LOCATION);
-      printf_P(PSTR("Settings loaded.\r\n"));
-    }
-
-    if (strncmp(res, "show", 5) == 0) {
-      valid = 1;
-      eeprom_read_block(&saved, (const void *)EEP_CONFFLAGS_LOCATION,
-                        (size_t)EEP_CONFFLAGS_SIZE);
-      eeprom_read_block(&baudtmp, (const void *)EEP_BAUDDIV_LOCATION,
-                        (size_t)EEP_BAUDDIV_SIZE);
-
-#ifdef SHORTENED_CONF_TEXT
-      printf_P(PSTR("Setting: cur / saved\r\ntranslate:\t%c\t%c\r\n"),
-               (confflags & CONF_TRANSLATE) ? 'Y' : 'N',
-               (saved & CONF_TRANSLATE) ? 'Y' : 'N');
-      printf_P(PSTR("crlf:\t\t%c\t%c\r\n"), (confflags & CONF_CRLF) ? 'Y' : 'N',
-               (saved & CONF_CRLF) ? 'Y' : 'N');
-      printf_P(PSTR("autocr:\t\t%c\t%c\r\n"),
-               (confflags & CONF_AUTOCR) ? 'Y' : 'N',
-               (saved & CONF_AUTOCR) ? 'Y' : 'N');
-      printf_P(PSTR("usos:\t\t%c\t%c\r\n"),
-               (confflags & CONF_UNSHIFT_ON_SPACE) ? 'Y' : 'N',
-               (saved & CONF_UNSHIFT_ON_SPACE) ? 'Y' : 'N');
-      printf_P(PSTR("showbreak:\t%c\t%c\r\n"),
-               (confflags & CONF_SHOWBREAK) ? 'Y' : 'N',
-               (saved & CONF_SHOWBREAK) ? 'Y' : 'N');
-      printf_P(PSTR("8bit:\t\t%c\t%c\r\n"), (confflags & CONF_8BIT) ? 'Y' : 'N',
-               (saved & CONF_8BIT) ? 'Y' : 'N');
-      printf_P(PSTR("table:\t\t%u\t%u\r\n"), tableselector,
-               eeprom_read_byte(EEP_TABLE_SELECT_LOCATION));
-      printf_P(PSTR("baud:\t\t%u\t%u\r\n"), divisor_to_baud(OCR1A),
-               divisor_to_baud(baudtmp));
-#else
-
-      printf_P(
-          PSTR("Settings:                                  Cur     Saved\r\n"));
-
-      printf_P(
-          PSTR("[no]translate   Translate ASCII/Baudot:    %c      %c\r\n"),
-          (confflags & CONF_TRANSLATE) ? 'Y' : 'N',
-          (saved & CONF_TRANSLATE) ? 'Y' : 'N');
-
-      printf_P(
-          PSTR("[no]crlf        CR or LF --> CR+LF:        %c      %c\r\n"),
-          (confflags & CONF_CRLF) ? 'Y' : 'N', (saved & CONF_CRLF) ? 'Y' : 'N');
-
-      printf_P(
-          PSTR("[no]autocr      Send CRLF at end of line:  %c      %c\r\n"),
-          (confflags & CONF_AUTOCR) ? 'Y' : 'N',
-          (saved & CONF_AUTOCR) ? 'Y' : 'N');
-
-      printf_P(
-          PSTR("[no]usos        Unshift on space:          %c      %c\r\n"),
-          (confflags & CONF_UNSHIFT_ON_SPACE) ? 'Y' : 'N',
-          (saved & CONF_UNSHIFT_ON_SPACE) ? 'Y' : 'N');
-
-      printf_P(
-          PSTR("[no]showbreak   Display received breaks:   %c      %c\r\n"),
-          (confflags & CONF_SHOWBREAK) ? 'Y' : 'N',
-          (saved & CONF_SHOWBREAK) ? 'Y' : 'N');
-
-      printf_P(
-          PSTR("[no]8bit        8bit mode:                 %c      %c\r\n"),
-          (confflags & CONF_8BIT) ? 'Y' : 'N', (saved & CONF_8BIT) ? 'Y' : 'N');
-
-#ifdef INCLUDE_AUTOPRINT
-      printf_P(
-          PSTR("[no]autoprint   autoprint mode:            %c      %c\r\n"),
-          (confflags & CONF_AUTOPRINT) ? 'Y' : 'N',
-          (saved & CONF_AUTOPRINT) ? 'Y' : 'N');
+    // Inline command escape timing runs off the clock, not off input.
+    escape_task();
+    lineout_task();
+    profile_task();
+    // Nothing of ours goes into a dead loop either. An open loop is quiet,
+    // not idle: the sched clocks start over once it's back.
+#ifdef INCLUDE_UTF8
+    if (!spooling)
+      utf8_drain();
 #endif
-
-      printf_P(
-          PSTR("table N         Translation table number:  %u      %u\r\n"),
-          tableselector, eeprom_read_byte(EEP_TABLE_SELECT_LOCATION));
-
-      printf_P(PSTR("baud N          Baud rate:                 %u     %u\r\n"),
-               divisor_to_baud(OCR1A), divisor_to_baud(baudtmp));
-#endif
-    }
-
-    // confflags settings. This has the potential to turn into a mess, try to
-    // keep the number of config settings to a minimum, especially ones that
-    // impact each other.
-
-    if (strncmp(res, "translate", 10) == 0) {
-      valid = 1;
-      confflags |= CONF_TRANSLATE;
-      printf_P(PSTR("Set to ASCII/Baudot translate mode.\r\n"));
-    }
-
-    if ((strncmp(res, "notranslate", 12) == 0) ||
-        (strncmp(res, "passthru", 9) == 0)) {
-      valid = 1;
-      confflags &= ~CONF_TRANSLATE;
-      printf_P(PSTR("Set to passthru mode.\r\n"));
-    }
-
-    if (strncmp(res, "crlf", 5) == 0) {
-      valid = 1;
-      confflags |= CONF_CRLF;
-      printf_P(PSTR("CR or LF --> CRLF.\r\n"));
-    }
-
-    if (strncmp(res, "nocrlf", 7) == 0) {
-      valid = 1;
-      confflags &= ~CONF_CRLF;
-      printf_P(PSTR("CR & LF independent.\r\n"));
-    }
-
-    if (strncmp(res, "showbreak", 10) == 0) {
-      valid = 1;
-      confflags |= CONF_SHOWBREAK;
-      printf_P(PSTR("Show break indicator.\r\n"));
-    }
-
-    if (strncmp(res, "noshowbreak", 12) == 0) {
-      valid = 1;
-      confflags &= ~CONF_SHOWBREAK;
-      printf_P(PSTR("Do not show break indicator.\r\n"));
-    }
-
 #ifdef INCLUDE_AUTOPRINT
-    if (strncmp(res, "autoprint", 10) == 0) {
-      valid = 1;
-      confflags |= CONF_AUTOPRINT;
-      printf_P(PSTR("Print saved text on break.\r\n"));
-    }
-
-    if (strncmp(res, "noautoprint", 12) == 0) {
-      valid = 1;
-      confflags &= ~CONF_AUTOPRINT;
-      printf_P(PSTR("Do not print saved text on break.\r\n"));
+    if (spooling)
+      sched_restart();
+    else {
+      sched_task();
+      sched_drain();
     }
 #endif
+    shift_task();
 
-    if (strncmp(res, "8bit", 5) == 0) {
-      valid = 1;
-      confflags |= CONF_8BIT;
-      confflags &= ~CONF_TRANSLATE;
-      printf_P(PSTR("8 bit mode for ascii machines.\r\n"));
-    }
-
-    if (strncmp(res, "no8bit", 7) == 0) {
-      valid = 1;
-      confflags &= ~CONF_8BIT;
-      // turning on 8bit mode forces translate mode off.
-      // But on turning off 8bit mode, do we force translate mode on? I think
-      // it's better to revert to whatever setting the user has previously
-      // saved.
-      eeprom_read_block(&saved, (const void *)EEP_CONFFLAGS_LOCATION,
-                        (size_t)EEP_CONFFLAGS_SIZE);
-      if (saved & CONF_TRANSLATE)
-        confflags |= CONF_TRANSLATE;
-      printf_P(PSTR("normal mode for 5-level machines.\r\n"));
-    }
-
-    if (strncmp(res, "autocr", 7) == 0) {
-      valid = 1;
-      confflags |= CONF_AUTOCR;
-      printf_P(PSTR("Auto-CRLF at end of line.\r\n"));
-    }
-    if (strncmp(res, "noautocr", 9) == 0) {
-      valid = 1;
-      confflags &= ~CONF_AUTOCR;
-      printf_P(PSTR("No Auto-CRLF at end of line.\r\n"));
-    }
-
-    if (strncmp(res, "usos", 5) == 0) {
-      valid = 1;
-      confflags |= CONF_UNSHIFT_ON_SPACE;
-      printf_P(PSTR("Unshift-on-space enabled.\r\n"));
-    }
-
-    if (strncmp(res, "nousos", 7) == 0) {
-      valid = 1;
-      confflags &= ~CONF_UNSHIFT_ON_SPACE;
-      printf_P(PSTR("Unshift-on-space disabled.\r\n"));
-    }
-
-    if (strncmp(res, "baud", 5) == 0) {
-      valid = 1;
-      res = strtok(NULL, " ");
-      if (res != NULL) {
-        baudtmp = baud_to_divisor(atoi(res));
-        // if user entered a nonstandard baud rate, wing it.
-        if (baudtmp == 0) {
-          printf_P(PSTR("Nonstandard baud rate selected, winging it.\r\n"));
-          baudtmp = F_CPU / 64 / 3 / (unsigned long)atoi(res);
-        }
-        printf_P(PSTR("Baud rate set to %s (divisor %u)\r\n"), res, baudtmp);
-        set_softuart_divisor(baudtmp);
-      } else {
-        printf_P(PSTR("baud <45|50|56|75>\r\n"));
-      }
-    }
-
-    if (strncmp(res, "table", 6) == 0) {
-      valid = 1;
-      res = strtok(NULL, " ");
-      if (res != NULL) {
-        tableselector = atoi(res);
-        if ((tableselector < 0) || (tableselector > 6)) {
-          printf_P(PSTR("Table numbers are 0 - 6; selecting 0.\r\n"));
-          tableselector = 0;
-        } else
-          printf_P(PSTR("Selected translation table #%u\r\n"), tableselector);
-      } else
-        printf_P(PSTR("table <0-6>\r\n"));
-    }
-
-    if (strncmp(res, "eedump", 7) == 0) {
-      valid = 1;
-      ee_dump();
-    }
-
-    if (strncmp(res, "eewipe", 7) == 0) {
-      valid = 1;
-      ee_wipe();
-    }
-#ifdef INCLUDE_AUTOPRINT
-    if (strncmp(res, "automsg", 8) == 0) {
-      valid = 1;
-      create_automsg();
-    }
-#endif
+    // Process USB events.
+    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
+    USB_USBTask();
 
-#ifdef EEWRITE
-    if (strncmp(res, "eewrite", 8) == 0) {
-      valid = 1;
-      res = strtok(NULL, " ");
-      if (res != NULL) {
-        ee_write(res);
-      }
-    }
-#endif
-    if (valid == 0)
-      printf("No such command.\r\n");
+    // Nothing left to do this time around? Host bytes only count if we
+    // could take one; while the TX queue is full or a fill is running, the TX
+    // timer or the tick wakes us.
+    if (!host_take_ready(relay_state) ||
+        !CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface))
+      idle_sleep();
   }
 }
 
@@ -611,10 +545,24 @@ void EVENT_USB_Device_Connect(void) {}
 /** Event handler for the library USB Disconnection event. */
 void EVENT_USB_Device_Disconnect(void) {}
 
+/** Event handlers for the library USB Suspend and Wake Up events. */
+void EVENT_USB_Device_Suspend(void) { usb_suspended = 1; }
+
+void EVENT_USB_Device_WakeUp(void) { usb_suspended = 0; }
+
 /** Event handler for the library USB Configuration Changed event. */
 void EVENT_USB_Device_ConfigurationChanged(void) {
   bool ConfigSuccess = true;
   ConfigSuccess &= CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface);
+  if (boot_usb_ms == 0)
+    boot_usb_ms = millis();
+}
+
+// TRUE once the host has configured us and opened the port (raised DTR).
+uint8_t usb_host_ready(void) {
+  return (USB_DeviceState == DEVICE_STATE_Configured) &&
+         (VirtualSerial_CDC_Interface.State.ControlLineStates.HostToDevice &
+          CDC_CONTROL_LINE_OUT_DTR);
 }
 
 /** Event handler for the library USB Control Request reception event. */
@@ -683,57 +631,80 @@ void EVENT_CDC_Device_LineEncodingChanged(
 void ee_dump(void) {
   uint16_t i;
   for (i = 0; i < 1024; i++) {
-    if (!(i % 16))
-      printf("\r\n%04x ", i);
-    printf("%02x ", eeprom_read_byte((const uint8_t *)i));
+    if (!(i % 16)) {
+      out_crlf();
+      out_hex16(i);
+      out_char(' ');
+    }
+    out_hex8(eeprom_read_byte((const uint8_t *)i));
+    out_char(' ');
   }
-  printf("\r\n");
+  out_crlf();
 }
 
-const char ltrs[32] PROGMEM = {0,    'E', 0x0A, 'A', ' ', 'S', 'I', 'U',
-                               0x0D, 'D', 'R',  'J', 'N', 'F', 'C', 'K',
-                               'T',  'Z', 'L',  'W', 'H', 'Y', 'P', 'Q',
-                               'O',  'B', 'G',  0,   'M', 'X', 'V', 0};
-
-const char figs[32] PROGMEM = {0,    '3', 0x0A, '-',  ' ', '\'', '8', '7',
-                               0x0D, 0x05, '4',  0x07, ',', '$', ':', '(',
-                               '5',  '+', ')',  '2',  '#', '6', '0', '1',
-                               '9',  '?', '&',  0,   '.', '/', '=', 0};
+// default table byte i, LTRS half first then FIGS, as laid out in eeprom
+static uint8_t default_table_byte(uint8_t i) {
+  return pgm_read_byte(&(table_flash[0][i]));
+}
 
 void ee_wipe(void) {
-  uint16_t i;
+  uint8_t i;
+  struct config c;
 
-  for (i = 0; i < 128; i++) { // only wipe first 128 bytes for now
-    if (i % 4 == 0)
-      usb_serial_putchar('.');
-    eeprom_write_byte(i, 0xff);
-  }
-  // put in some sane defaults or it will hang on next boot.
-  // i = 1833; // 45.45 baud
-  i = 1667; // 50 baud
-  eeprom_write_block(&i, (void *)EEP_BAUDDIV_LOCATION,
-                     (size_t)EEP_BAUDDIV_SIZE);
-  // i = CONF_TRANSLATE | CONF_CRLF | CONF_SHOWBREAK;
-  i = CONF_TRANSLATE | CONF_CRLF;
-  eeprom_write_block(&i, (void *)EEP_CONFFLAGS_LOCATION,
-                     (size_t)EEP_CONFFLAGS_SIZE);
+  config_wipe();
   // copy the default ascii/baudot translation table from flash to eeprom
-  for (i = 0; i < 32; i++) {
-    eeprom_write_byte(EEP_TABLES_START + i, pgm_read_byte(&(ltrs[i])));
-    eeprom_write_byte(EEP_TABLES_START + FIGS_OFFSET + i,
-                      pgm_read_byte(&(figs[i])));
+  for (i = 0; i < EEP_TABLE_SIZE; i++) {
+    if (i % 8 == 0)
+      usb_serial_putchar('.');
+    eeprom_write_byte((uint8_t *)(EEP_TABLES_START + i),
+                      default_table_byte(i));
   }
+  profile_load_all();
 
-  // eeprom_write_block(&ltrs, (void *)EEP_TABLES_START, FIGS_OFFSET);
-  // eeprom_write_block(&figs, (void *)(EEP_TABLES_START+FIGS_OFFSET),
-  // FIGS_OFFSET);
+  // put in some sane defaults or it will hang on next boot.
+  config_defaults(&c);
+  config_write(&c);
 
-  eeprom_write_byte(EEP_TABLE_SELECT_LOCATION, 0);
-  i = 0x4545; // magic number to indicate device has a configuration
-  eeprom_write_block(&i, (void *)EEP_CONFIGURED_LOCATION,
-                     (size_t)EEP_CONFIGURED_SIZE);
+  out_crlf();
+}
 
-  printf("\r\n");
+// Called from the main loop until boot_state is BOOT_DONE. Never waits on
+// the eeprom: a blank unit gets its default table one byte per call, only
+// when the previous write has finished, so USB keeps getting serviced.
+void boot_task(void) {
+  struct config c;
+
+  if (!eeprom_is_ready())
+    return;
+
+  switch (boot_state) {
+  case BOOT_LOAD:
+    if (config_load()) {
+      boot_state = BOOT_DONE;
+      break;
+    }
+    // a table someone loaded stays, only a blank eeprom gets the default
+    boot_step = (eeprom_read_byte((const uint8_t *)EEP_TABLES_START) == 0xFF)
+                    ? 0
+                    : EEP_TABLE_SIZE;
+    boot_state = BOOT_TABLES;
+    return;
+  case BOOT_TABLES:
+    if (boot_step < EEP_TABLE_SIZE) {
+      eeprom_update_byte((uint8_t *)(EEP_TABLES_START + boot_step),
+                         default_table_byte(boot_step));
+      boot_step++;
+      return;
+    }
+    config_defaults(&c);
+    config_write(&c);
+    config_load();
+    boot_state = BOOT_DONE;
+    break;
+  default:
+    return;
+  }
+  boot_config_ms = millis();
 }
 
 void usbserial_tasks(void) {
@@ -766,15 +737,10 @@ uint16_t baud_to_divisor(uint16_t baud) {
 void set_softuart_divisor(uint16_t divisor) {
   TCNT1 = 0;
   OCR1A = divisor;
-}
-
-void help(void) {
-  printf_P(PSTR("\r\nCommands available:\r\nhelp, baud, table, [no]translate, "
-                "[no]usos, [no]autocr, [no]showbreak, [no]8bit,\r\n"));
-#ifdef INCLUDE_AUTOPRINT
-  printf_P(PSTR("[no]autoprint, automsg, "));
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    hwuart_set_divisor(divisor);
 #endif
-  printf_P(PSTR("save, load, show, exit\r\n"));
 }
 
 #ifdef EEWRITE
@@ -812,10 +778,14 @@ void ee_write(char *buf) {
   for (i = 0; ishexchar(buf[i]) && ishexchar(buf[i + 1]) &&
               i < strnlen(buf, CMDBUFLEN);
        i = i + 3) { // skip a space after each byte
-    printf_P(PSTR("%u (%04x): %u (%02X)\r\n"), eeaddr + j, eeaddr + j,
-             unhex(buf[i], buf[i + 1]), unhex(buf[i], buf[i + 1]));
-    eeprom_write_byte(eeaddr + j, unhex(buf[i], buf[i + 1]));
+    out_msg(PSTR(""), eeaddr + j, PSTR(" ("));
+    out_hex16(eeaddr + j);
+    out_msg(PSTR("): "), unhex(buf[i], buf[i + 1]), PSTR(" ("));
+    out_hex8(unhex(buf[i], buf[i + 1]));
+    out_str_P(PSTR(")\r\n"));
+    eeprom_write_byte((uint8_t *)(eeaddr + j), unhex(buf[i], buf[i + 1]));
     j++;
   }
+  profile_load_all(); // in case that was a table
 }
 #endif
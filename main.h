@@ -4,3 +4,22 @@
 #define BUTTON_PIN _BV(4)
 
 #define RELAY_USB_CONTROL 1
+
+#define EEWRITE
+
+// tested speeds, {baud, divisor}
+#define NSPEEDS 5
+extern const uint16_t speeds[NSPEEDS][2];
+
+// things in main.c the command line needs
+void ee_dump(void);
+void ee_wipe(void);
+void ee_write(char *);
+void softuart_status(void);
+uint16_t divisor_to_baud(uint16_t);
+uint16_t baud_to_divisor(uint16_t);
+void set_softuart_divisor(uint16_t);
+void usbserial_tasks(void);
+
+// the host to loop data path
+void host_to_loop(char c);
@@ -0,0 +1,92 @@
+/* Output to the host without stdio.
+ *
+ * printf_P() would go through avr-libc's vfprintf and a LUFA stream for
+ * every char, and parse its format at run time. Everything the firmware says
+ * to the host goes through these instead, so neither gets linked: they
+ * write bytes straight into the CDC IN endpoint, where CDC_Device_SendByte()
+ * only sends a packet once the bank is full, and whatever is left goes out at
+ * the next CDC_Device_USBTask(). Text stays in flash. Hex is upper case. */
+
+#include "out.h"
+#include "lufa_serial.h"
+#include "stats.h"
+
+extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface; // from main.c
+
+static const char hexdigits[] PROGMEM = "0123456789ABCDEF";
+
+void out_char(char c) {
+  stats.usb_in_bytes++;
+  if (CDC_Device_SendByte(&VirtualSerial_CDC_Interface, (uint8_t)c) !=
+      ENDPOINT_RWSTREAM_NoError)
+    stats.usb_in_stalls++;
+}
+
+void out_str(const char *s) {
+  while (*s)
+    out_char(*s++);
+}
+
+void out_str_P(PGM_P s) {
+  char c;
+
+  while ((c = pgm_read_byte(s++)))
+    out_char(c);
+}
+
+// s, then spaces out to w columns, like "%-*s"
+void out_field(const char *s, uint8_t w) {
+  while (*s) {
+    out_char(*s++);
+    if (w)
+      w--;
+  }
+  while (w--)
+    out_char(' ');
+}
+
+void out_field_P(PGM_P s, uint8_t w) {
+  char c;
+
+  while ((c = pgm_read_byte(s++))) {
+    out_char(c);
+    if (w)
+      w--;
+  }
+  while (w--)
+    out_char(' ');
+}
+
+void out_crlf(void) {
+  out_char('\r');
+  out_char('\n');
+}
+
+void out_hex8(uint8_t b) {
+  out_char(pgm_read_byte(&hexdigits[b >> 4]));
+  out_char(pgm_read_byte(&hexdigits[b & 0x0F]));
+}
+
+void out_hex16(uint16_t w) {
+  out_hex8(w >> 8);
+  out_hex8(w);
+}
+
+void out_dec(uint32_t n) {
+  char buf[10]; // 4294967295
+  uint8_t i = 0;
+
+  do {
+    buf[i++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  while (i)
+    out_char(buf[--i]);
+}
+
+// the usual "Width is 10 - 132.\r\n" message, pre and post in flash
+void out_msg(PGM_P pre, uint32_t n, PGM_P post) {
+  out_str_P(pre);
+  out_dec(n);
+  out_str_P(post);
+}
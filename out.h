@@ -0,0 +1,20 @@
+// Output to the host without stdio. See out.c.
+
+#ifndef _OUT_H_
+#define _OUT_H_
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+void out_char(char c);
+void out_str(const char *s);
+void out_str_P(PGM_P s);
+void out_field(const char *s, uint8_t w);
+void out_field_P(PGM_P s, uint8_t w);
+void out_crlf(void);
+void out_hex8(uint8_t b);
+void out_hex16(uint16_t w);
+void out_dec(uint32_t n);
+void out_msg(PGM_P pre, uint32_t n, PGM_P post);
+
+#endif
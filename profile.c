@@ -0,0 +1,264 @@
+/* Translation profiles.
+ *
+ * Each profile holds a copy of one of the tables in RAM, so translating
+ * never touches the eeprom and switching is instant. The one in profile_cur
+ * is used both ways. "profile N T" puts table T in profile N, and the choice
+ * is saved with the rest of the settings.
+ *
+ * Tables live in the eeprom, as many as fit between the settings and the
+ * autoprint message (or the spool), or in flash (table_flash, numbered
+ * after the eeprom ones). The first byte of a table, where code 0 would be,
+ * says how wide the codes are:
+ *
+ *   0, 5, blank  5 bit ITA2: 32 LTRS chars then 32 FIGS, shifts are the
+ *                usual 0x1F and 0x1B.
+ *   6            6 bit (TTS and the like), two blocks: 64 LTRS then 64
+ *                FIGS. The codes that shift hold SI (to LTRS) and SO (to
+ *                FIGS) instead of a char.
+ *   7, 8         two blocks, one char per code and no shifts. 8 bit codes
+ *                go out with the top bit clear, and it's ignored coming in.
+ *
+ * Code 0 never translates. A wide table starting in the last block of the
+ * eeprom doesn't fit, and is read as 5 bit. The main loop sets the frame
+ * length from the width (see main.c), so a switch to a profile of another
+ * width also waits for the TX queue to empty.
+ *
+ * The host switches in band, so different feeds can share the machine
+ * without going through the command line: SO followed by a digit selects
+ * that profile, SI goes back to profile 0. Neither has a Baudot code. The
+ * switch waits for lineout to send whatever it still holds (a word being
+ * wrapped, a fill), so text before it comes out in the old profile, and
+ * the main loop takes nothing else from the host until it's done. */
+
+#include "profile.h"
+#include "baudot.h"
+#include "lineout.h"
+#include "stats.h"
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+
+extern volatile unsigned char flag_tx_ready; // from softuart.c
+
+// the default, written to eeprom table 0 on a blank unit, and the US
+// variant (bell on S, $ on D, ' on J, ! on F, " on Z, ; on V)
+const char table_flash[TABLES_FLASH][EEP_TABLE_SIZE] PROGMEM = {
+    {0,    'E', 0x0A, 'A',  ' ', 'S',  'I', 'U', // ITA2, LTRS
+     0x0D, 'D', 'R',  'J',  'N', 'F',  'C', 'K',
+     'T',  'Z', 'L',  'W',  'H', 'Y',  'P', 'Q',
+     'O',  'B', 'G',  0,    'M', 'X',  'V', 0,
+     0,    '3', 0x0A, '-',  ' ', '\'', '8', '7', // FIGS
+     0x0D, 0x05, '4', 0x07, ',', '$',  ':', '(',
+     '5',  '+', ')',  '2',  '#', '6',  '0', '1',
+     '9',  '?', '&',  0,    '.', '/',  '=', 0},
+    {0,    'E', 0x0A, 'A',  ' ', 'S',  'I', 'U', // US, LTRS
+     0x0D, 'D', 'R',  'J',  'N', 'F',  'C', 'K',
+     'T',  'Z', 'L',  'W',  'H', 'Y',  'P', 'Q',
+     'O',  'B', 'G',  0,    'M', 'X',  'V', 0,
+     0,    '3', 0x0A, '-',  ' ', 0x07, '8', '7', // FIGS
+     0x0D, '$', '4',  '\'', ',', '!',  ':', '(',
+     '5',  '"', ')',  '2',  '#', '6',  '0', '1',
+     '9',  '?', '&',  0,    '.', '/',  ';', 0},
+};
+
+uint8_t profile_table[PROFILES];
+uint8_t profile_cur = 0;
+char profile_ram[PROFILES][TABLE_MAX];
+uint8_t profile_width[PROFILES];
+static uint8_t profile_ltrs[PROFILES]; // shift codes, 0 if it has none
+static uint8_t profile_figs[PROFILES];
+
+static uint8_t so_seen = 0;  // SO, the digit comes next
+static int8_t switch_to = -1; // waiting on lineout
+
+// read n blocks of table t
+static void table_read(char *dst, uint8_t t, uint8_t n) {
+  if (t < TABLES_EEP)
+    eeprom_read_block(dst,
+                      (const void *)(EEP_TABLES_START + EEP_TABLE_SIZE * t),
+                      EEP_TABLE_SIZE * n);
+  else
+    memcpy_P(dst, table_flash[t - TABLES_EEP], EEP_TABLE_SIZE * n);
+}
+
+// bytes in a table whose first byte is b
+uint8_t table_size(uint8_t b) {
+  return ((b >= 6) && (b <= 8)) ? TABLE_MAX : EEP_TABLE_SIZE;
+}
+
+// Read table n into t. Returns its size, which is one block if it's a
+// wide table that doesn't fit where it starts.
+uint8_t table_get(uint8_t n, char *t) {
+  table_read(t, n, 1);
+  if ((table_size(t[0]) == EEP_TABLE_SIZE) || (n == TABLES_EEP - 1) ||
+      (n == TABLES - 1))
+    return EEP_TABLE_SIZE;
+  table_read(t, n, 2);
+  return TABLE_MAX;
+}
+
+// (re)read profile p's table, after it changed or was edited
+void profile_load(uint8_t p) {
+  char *r = profile_ram[p];
+  uint8_t w, i;
+
+  w = (table_get(profile_table[p], r) == EEP_TABLE_SIZE) ? 5 : r[0];
+  r[0] = 0;
+  profile_width[p] = w;
+  profile_ltrs[p] = profile_figs[p] = 0;
+  if (w == 5) {
+    profile_ltrs[p] = LTRS;
+    profile_figs[p] = FIGS;
+  } else if (w == 6)
+    for (i = 1; i < 64; i++) {
+      if ((r[i] == PROFILE_SI) || (r[64 + i] == PROFILE_SI))
+        profile_ltrs[p] = i;
+      if ((r[i] == PROFILE_SO) || (r[64 + i] == PROFILE_SO))
+        profile_figs[p] = i;
+    }
+}
+
+void profile_load_all(void) {
+  uint8_t p;
+
+  for (p = 0; p < PROFILES; p++)
+    profile_load(p);
+}
+
+void profile_select(uint8_t p) {
+  if (p != profile_cur)
+    stats.profiles++;
+  profile_cur = p;
+}
+
+// Called with every char from the host in translate mode. Returns TRUE if
+// it was part of a switch, so it must not go to the loop. An SO that isn't
+// followed by a profile number is dropped.
+uint8_t profile_filter(char c) {
+  if (so_seen) {
+    so_seen = 0;
+    if ((c >= '0') && (c < '0' + PROFILES)) {
+      switch_to = c - '0';
+      profile_task();
+      return 1;
+    }
+    stats.dropped++;
+  }
+  if (c == PROFILE_SO) {
+    so_seen = 1;
+    return 1;
+  }
+  if (c == PROFILE_SI) {
+    switch_to = 0;
+    profile_task();
+    return 1;
+  }
+  return 0;
+}
+
+// TRUE while a switch is waiting for earlier text to go out
+uint8_t profile_pending(void) { return switch_to >= 0; }
+
+void profile_task(void) {
+  if ((switch_to >= 0) && lineout_idle() &&
+      ((profile_width[switch_to] == profile_width[profile_cur]) ||
+       !flag_tx_ready)) {
+    profile_select(switch_to);
+    switch_to = -1;
+  }
+}
+
+// codes per case in the profile in use: 32, 64 or 128. An 8 bit table has
+// the same 128 as a 7 bit one, it's all TABLE_MAX holds; the top bit of
+// an 8 bit code is dropped coming in and sent clear.
+uint8_t profile_codes(void) {
+  uint8_t w = profile_width[profile_cur];
+
+  return 1 << ((w > 7) ? 7 : w);
+}
+
+// the code that shifts to LTRS or FIGS, 0 if the table has none
+uint8_t profile_code(uint8_t shift) {
+  return (shift == FIGS) ? profile_figs[profile_cur]
+                         : profile_ltrs[profile_cur];
+}
+
+// LTRS or FIGS if code is one of the shifts, else 0
+uint8_t profile_shift(uint8_t code) {
+  if (!code)
+    return 0;
+  if (code == profile_ltrs[profile_cur])
+    return LTRS;
+  if (code == profile_figs[profile_cur])
+    return FIGS;
+  return 0;
+}
+
+// Check a table before it goes in the eeprom: a char may only be on one
+// code per case, the LTRS/FIGS codes of a 5 bit table are left blank, and a
+// 6 bit table has one SO and one SI code, the same in both cases. Returns
+// what's wrong and where, or NULL.
+PGM_P table_check(const char *t, uint8_t *at) {
+  uint8_t w = t[0], n, cases, h, i, c;
+  uint8_t seen[32]; // one bit per char
+  uint8_t so = 0, si = 0;
+
+  if (w == 0xFF) // blank, 5 bit like table_size() reads it
+    w = 5;
+  if ((w != 0) && ((w < 5) || (w > 8))) {
+    *at = 0;
+    return PSTR("width must be 0, 5-8 or blank");
+  }
+  n = (w == 6) ? 64 : (w > 6) ? 128 : 32;
+  cases = (w > 6) ? 1 : 2;
+  for (h = 0; h < cases; h++) {
+    memset(seen, 0, sizeof(seen));
+    for (i = 1; i < n; i++) {
+      *at = h * n + i;
+      c = t[*at];
+      if ((n == 32) && ((i == LTRS) || (i == FIGS))) {
+        if (c)
+          return PSTR("LTRS/FIGS code holds a char");
+        continue;
+      }
+      if ((c == PROFILE_SO) || (c == PROFILE_SI)) {
+        if (w != 6)
+          return PSTR("SO/SI outside a 6 bit table");
+        if (t[(1 - h) * n + i] != c)
+          return PSTR("shift differs between cases");
+        if (h == 0) {
+          if ((c == PROFILE_SO) ? so++ : si++)
+            return PSTR("more than one SO/SI code");
+        }
+        continue;
+      }
+      if (!c)
+        continue;
+      if (seen[c >> 3] & (1 << (c & 7)))
+        return PSTR("char already on another code");
+      seen[c >> 3] |= 1 << (c & 7);
+    }
+  }
+  *at = 0;
+  if ((w == 6) && (!so || !si))
+    return PSTR("6 bit table needs SO and SI");
+  return NULL;
+}
+
+// Put checked table t (table_size() bytes) in eeprom table number n, and
+// reload any profile using it. Returns 0 if it doesn't fit there.
+uint8_t table_write(uint8_t n, const char *t) {
+  uint8_t size = table_size(t[0]);
+
+  if (n + size / EEP_TABLE_SIZE > TABLES_EEP)
+    return 0;
+  eeprom_update_block(t, (void *)(EEP_TABLES_START + EEP_TABLE_SIZE * n),
+                      size);
+  profile_load_all();
+  return 1;
+}
+
+// what code prints in LTRS, for space and CR, which are in both
+char profile_char(uint8_t code) {
+  return profile_ram[profile_cur][code & (profile_codes() - 1)];
+}
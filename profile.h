@@ -0,0 +1,56 @@
+// Translation profiles: tables kept in RAM, switched from the host in band.
+// See profile.c.
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "conf.h"
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#define PROFILES 4
+
+// Table numbers count EEP_TABLE_SIZE blocks, from EEP_TABLES_START to the
+// autoprint message (or the spool without it), then the ones
+// built into flash. A table wider than 5 bits takes two blocks.
+#ifdef INCLUDE_AUTOPRINT
+#define EEP_TABLES_END EEP_AUTOMSG_START
+#else
+#define EEP_TABLES_END EEP_SPOOL_START
+#endif
+#define TABLES_EEP ((EEP_TABLES_END - EEP_TABLES_START) / EEP_TABLE_SIZE)
+#define TABLES_FLASH 2
+#define TABLES (TABLES_EEP + TABLES_FLASH)
+// Two blocks at most, so a 7 or 8 bit table has 128 codes: 8 bit codes
+// only use the low 7 bits (see profile_codes()).
+#define TABLE_MAX (2 * EEP_TABLE_SIZE)
+
+// from the host in translate mode: SO then a digit switches to that
+// profile, SI goes back to profile 0. In a 6 bit table they mark the codes
+// that shift to FIGS and LTRS.
+#define PROFILE_SO 0x0E
+#define PROFILE_SI 0x0F
+
+extern uint8_t profile_table[PROFILES]; // table each one holds
+extern uint8_t profile_cur;             // the one translating now
+extern char profile_ram[PROFILES][TABLE_MAX];
+extern uint8_t profile_width[PROFILES]; // bits per code, 5 - 8
+extern const char table_flash[TABLES_FLASH][EEP_TABLE_SIZE];
+
+void profile_load(uint8_t p);
+void profile_load_all(void);
+void profile_select(uint8_t p);
+uint8_t profile_filter(char c);
+uint8_t profile_pending(void);
+void profile_task(void);
+uint8_t profile_codes(void);
+uint8_t profile_code(uint8_t shift);
+uint8_t profile_shift(uint8_t code);
+char profile_char(uint8_t code);
+uint8_t table_size(uint8_t b);
+uint8_t table_get(uint8_t n, char *t);
+PGM_P table_check(const char *t, uint8_t *at);
+uint8_t table_write(uint8_t n, const char *t);
+
+#endif
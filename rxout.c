@@ -0,0 +1,270 @@
+/* The loop to host data path: take what the softuart received and pass it
+ * to USB in the format rxmode asks for.
+ *
+ * In char mode every char is its own USB write, which is what a terminal
+ * wants and a logger doesn't. Line and record mode collect text in a RAM
+ * line buffer and send it in one write when the line ends, when it's
+ * RXOUT_LINE long, or when nothing's come for RXOUT_LINE_WAIT ms. Any run
+ * of CR and LF counts as one line end, except that each LF not straight
+ * after a CR is a (blank) line; it goes to the host as CR LF. "rxmode line
+ * stamp" puts the millis() when each line started in front of it, and
+ * record mode sends LINE_SYNC records instead, with capdecode -r to read
+ * them. */
+
+#include "rxout.h"
+#include "baudot.h"
+#include "conf.h"
+#include "lufa_serial.h"
+#include "out.h"
+#include "shift.h"
+#include "softuart.h"
+#include "stats.h"
+#include "tick.h"
+#include "usb_serial_getstr.h"
+#ifdef INCLUDE_UTF8
+#include "utf8.h"
+#endif
+
+extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface;
+extern uint16_t confflags;       // from main.c
+extern uint8_t baudot_shift_rcv; // from baudot.c
+
+uint8_t rxmode = RXMODE_CHAR;
+uint8_t rxstamp = 0;
+
+static char line[LINE_HDRLEN + RXOUT_LINE]; // room for the record header
+static uint8_t line_n = 0;    // text in it, after the header
+static uint8_t line_more = 0; // some of this line has gone already
+static char line_end = '\n';  // what ended the last line, 0 after text
+static uint32_t line_ms;      // when its first char came
+static uint32_t line_last;    // and the last
+
+static void line_stamp(void) {
+  uint16_t ms = line_ms % 1000;
+
+  out_char('[');
+  out_dec(line_ms / 1000);
+  out_char('.');
+  out_char('0' + ms / 100);
+  out_char('0' + ms / 10 % 10);
+  out_char('0' + ms % 10);
+  out_str_P(PSTR("] "));
+}
+
+// Send what's in the line buffer, done if the line ended there, and flush
+// so it goes as one packet where it fits.
+static void line_send(uint8_t done) {
+  uint8_t *h = (uint8_t *)line;
+  uint8_t len = line_n;
+
+  if (!line_n && !line_more) // a blank line, it starts now
+    line_ms = millis();
+  if (rxmode == RXMODE_RECORD) {
+    h[0] = LINE_SYNC;
+    h[1] = done ? 0 : LINE_MORE;
+    h[2] = line_n;
+    h[3] = line_ms & 0xFF;
+    h[4] = (line_ms >> 8) & 0xFF;
+    h[5] = (line_ms >> 16) & 0xFF;
+    len += LINE_HDRLEN;
+  } else {
+    if (rxstamp && !line_more)
+      line_stamp();
+    h += LINE_HDRLEN;
+  }
+  stats.usb_in_bytes += len;
+  if (len && (CDC_Device_SendData(&VirtualSerial_CDC_Interface, h, len) !=
+              ENDPOINT_RWSTREAM_NoError))
+    stats.usb_in_stalls++;
+  if (done && (rxmode == RXMODE_LINE))
+    out_crlf();
+  CDC_Device_Flush(&VirtualSerial_CDC_Interface);
+  line_more = !done;
+  line_n = 0;
+}
+
+static void line_put(char c) {
+  if (c == '\r') {
+    if (line_end) // nothing since the last line end
+      return;
+    line_send(1);
+    line_end = c;
+  } else if (c == '\n') {
+    if (line_end == '\r')
+      line_end = c; // the rest of CR LF
+    else {
+      line_send(1);
+      line_end = c;
+    }
+  } else {
+    line_last = millis();
+    if (!line_n)
+      line_ms = line_last;
+    line[LINE_HDRLEN + line_n++] = c;
+    line_end = 0;
+    if (line_n == RXOUT_LINE)
+      line_send(0);
+  }
+}
+
+#ifdef INCLUDE_LOGIC
+static uint8_t la_run_byte; // 0x00 or 0xFF being counted
+static uint8_t la_run = 0;  // how many of them so far
+static uint32_t la_run_ms;  // millis() when the run started
+
+static void logic_send(uint8_t b) {
+  stats.usb_in_bytes++;
+  if (CDC_Device_SendByte(&VirtualSerial_CDC_Interface, b) !=
+      ENDPOINT_RWSTREAM_NoError)
+    stats.usb_in_stalls++;
+}
+
+static void logic_flush_run(void) {
+  if (la_run) {
+    logic_send(la_run_byte);
+    logic_send(la_run);
+    la_run = 0;
+  }
+}
+
+// Stream whatever samples the ISR has collected, run length coding the
+// all mark / all space bytes.
+static void logic_drain(void) {
+  uint8_t b;
+
+  // the receiver still runs, nobody wants its output in this mode
+  while (softuart_kbhit())
+    softuart_getchar();
+
+  while (softuart_logic_get(&b)) {
+    if ((b == 0x00) || (b == 0xFF)) {
+      if (la_run && (b != la_run_byte))
+        logic_flush_run();
+      if (!la_run)
+        la_run_ms = millis();
+      la_run_byte = b;
+      if (++la_run == LA_RUN_MAX)
+        logic_flush_run();
+    } else {
+      logic_flush_run();
+      logic_send(b);
+    }
+  }
+  if (la_run && (millis() - la_run_ms >= LA_RUN_WAIT))
+    logic_flush_run();
+}
+#endif
+
+void rxout_set_mode(uint8_t mode) {
+  if (line_n)
+    line_send(0); // in the old mode
+  line_more = 0;
+  line_end = '\n';
+#ifdef INCLUDE_LOGIC
+  if (rxmode == RXMODE_LOGIC) {
+    softuart_logic(0);
+    logic_flush_run();
+  }
+  if (mode == RXMODE_LOGIC) {
+    la_run = 0;
+    softuart_logic(1);
+  }
+#endif
+  rxmode = mode;
+}
+
+#ifdef INCLUDE_CAPTURE
+// One record per received frame, sent as a single write so a record never
+// gets split around other output.
+static void capture_frame(void) {
+  uint8_t rec[CAP_RECLEN];
+  uint16_t stamp;
+  uint32_t now, t;
+  uint8_t flags;
+  char code;
+
+  code = softuart_getframe(&stamp, &flags);
+  // the ISR only keeps the low 16 bits; we're never 65s behind it
+  now = millis();
+  t = now - (uint16_t)((uint16_t)now - stamp);
+
+  if (confflags & CONF_8BIT)
+    flags |= CAP_8BIT;
+  else {
+    baudot_to_ascii(code); // just to keep track of the shift state
+    shift_heard(code, flags);
+  }
+  if (baudot_shift_rcv == FIGS)
+    flags |= CAP_FIGS;
+
+  rec[0] = CAP_SYNC;
+  rec[1] = flags;
+  rec[2] = code;
+  rec[3] = t & 0xFF;
+  rec[4] = (t >> 8) & 0xFF;
+  rec[5] = (t >> 16) & 0xFF;
+  stats.usb_in_bytes += CAP_RECLEN;
+  if (CDC_Device_SendData(&VirtualSerial_CDC_Interface, rec, CAP_RECLEN) !=
+      ENDPOINT_RWSTREAM_NoError)
+    stats.usb_in_stalls++;
+}
+#endif
+
+// do we have a character from the TTY loop ready to send to USB? If so,
+// process it.
+void loop_to_host(void) {
+  char char_from_tty;
+  uint8_t flags;
+  char code;
+  void (*put)(char);
+
+#ifdef INCLUDE_LOGIC
+  if (rxmode == RXMODE_LOGIC) {
+    logic_drain();
+    return;
+  }
+#endif
+
+  if (line_n && (millis() - line_last >= RXOUT_LINE_WAIT))
+    line_send(0);
+
+  if (!softuart_kbhit())
+    return;
+  stats.rx_chars++;
+
+#ifdef INCLUDE_CAPTURE
+  if (rxmode == RXMODE_CAPTURE) {
+    capture_frame();
+    return;
+  }
+#endif
+
+  flags = softuart_peekflags();
+  code = softuart_getchar();
+  if (confflags & CONF_TRANSLATE) {
+    char_from_tty = baudot_to_ascii(code);
+    shift_heard(code, flags);
+  } else if (confflags & CONF_8BIT)
+    char_from_tty = code;
+  else
+    char_from_tty = code & 0x1F; // masking may not be necessary
+
+  // the host already knows what it sent; shifts above still got tracked
+  if ((flags & SOFTUART_ECHO) && (confflags & CONF_DROPECHO)) {
+    stats.echoes++;
+    return;
+  }
+  if (char_from_tty == 0)
+    return;
+  put = ((rxmode == RXMODE_LINE) || (rxmode == RXMODE_RECORD))
+            ? line_put
+            : usb_serial_putchar;
+#ifdef INCLUDE_UTF8
+  if ((confflags & (CONF_TRANSLATE | CONF_UTF8OUT)) ==
+      (CONF_TRANSLATE | CONF_UTF8OUT)) {
+    utf8_to_host(char_from_tty, put);
+    return;
+  }
+#endif
+  put(char_from_tty);
+}
@@ -0,0 +1,38 @@
+// How traffic received off the loop is handed to the host. See rxout.c.
+
+#define RXMODE_CHAR 0    // each character as it arrives
+#define RXMODE_CAPTURE 1 // timestamped binary records, for capdecode
+#define RXMODE_LOGIC 2   // raw RX pin samples, for capdecode -l
+#define RXMODE_LINE 3    // text a line at a time, optionally timestamped
+#define RXMODE_RECORD 4  // a line at a time as binary records, capdecode -r
+
+// capture record: CAP_SYNC, flags, raw code, then millis() as 24 bits LSB
+// first. Flags are the SOFTUART_FE / SOFTUART_BREAK bits plus these.
+#define CAP_SYNC 0xA5
+#define CAP_RECLEN 6
+#define CAP_FIGS (1 << 2) // receive shift state after this code
+#define CAP_8BIT (1 << 3) // 8 bit frame
+
+// logic stream: bytes of 8 samples, oldest in the MSB, 1 = mark. A 0x00 or
+// 0xFF byte is always followed by a count (1-255) of how many of that byte
+// in a row, so idle line costs two bytes per 2040 samples. A run goes out
+// when it reaches LA_RUN_MAX, or LA_RUN_WAIT ms after it started, so the
+// host sees an idle line or a long break within a second even at 45 baud,
+// where 2040 samples take 15s.
+#define LA_RUN_MAX 255
+#define LA_RUN_WAIT 1000
+
+// line record: LINE_SYNC, flags, length, millis() when its first char came
+// as 24 bits LSB first, then that many bytes of text without the line end.
+#define LINE_SYNC 0xA6
+#define LINE_HDRLEN 6
+#define LINE_MORE (1 << 0) // cut short, the line goes on in the next record
+
+#define RXOUT_LINE 80        // longest line sent in one piece
+#define RXOUT_LINE_WAIT 2000 // ms before a quiet line goes out unfinished
+
+extern uint8_t rxmode;
+extern uint8_t rxstamp; // timestamp lines in RXMODE_LINE
+
+void rxout_set_mode(uint8_t mode);
+void loop_to_host(void);
@@ -0,0 +1,133 @@
+/* Printing the autoprint message on a timer.
+ *
+ * "sched every M" prints it every M minutes (a station ID, say), "sched
+ * idle S" once the loop has been quiet for S seconds, and not again until
+ * something else has been on it. 0 turns either off. The time comes from
+ * the Timer0 tick, so none of it needs the host; the PC can be off.
+ *
+ * A message that falls due waits for the carriage to be at the start of a
+ * line with nothing held in lineout, so it goes in between lines of host
+ * text rather than in the middle of one. If the host leaves a line unfinished
+ * and goes quiet for SCHED_LINE_WAIT ms, the message starts with CR LF
+ * instead. Only in translate mode, the message is text. While the loop is
+ * down (see spool.c) main() doesn't run any of this, and restarts the
+ * clocks, so nothing is printed into a dead loop.
+ *
+ * Like utf8.c, it's handed to the loop one char at a time by main(), as the
+ * TX queue has room, and main() takes nothing from the host until it's
+ * done, so nothing blocks and the receiver keeps running. */
+
+#ifdef INCLUDE_AUTOPRINT
+#include "sched.h"
+#include "conf.h"
+#include "lineout.h"
+#include "shift.h"
+#include "stats.h"
+#include "tick.h"
+#include <avr/eeprom.h>
+#include <avr/io.h>
+
+extern uint16_t confflags;                   // from main.c
+extern volatile unsigned char flag_tx_ready; // from softuart.c
+
+uint16_t sched_every = 0;
+uint16_t sched_idle = 0;
+
+static uint32_t every_ms;    // when the last "every" was due
+static uint32_t active_ms;   // last time anything was on the loop
+static uint32_t host_ms;     // or came from the host
+static uint32_t loop_chars;  // stats.rx_chars + stats.tx_chars then
+static uint32_t host_chars;  // stats.usb_out_bytes then
+static uint8_t idle_done;    // printed for this quiet spell already
+static uint8_t printing = 0; // ours is on the loop, echo and all
+static uint32_t done_ms;     // when it was last done
+static uint8_t due = 0;      // waiting for the end of a line
+static uint16_t msg_at;      // next eeprom byte, 0 when not printing
+static uint8_t msg_lead = 0; // CR LF still to go before the message
+static uint8_t msg_lf = 0;   // LF still to go after a CR
+
+// start counting from now, after the times were changed
+void sched_restart(void) {
+  every_ms = active_ms = host_ms = millis();
+  idle_done = 0;
+}
+
+static uint8_t msg_char(void) {
+  if (msg_at >= EEP_AUTOMSG_START + EEP_AUTOMSG_SIZE)
+    return 0xFF;
+  return eeprom_read_byte((const uint8_t *)msg_at);
+}
+
+void sched_task(void) {
+  uint32_t now = millis();
+  uint32_t n;
+
+  // Anything on the loop that isn't us printing starts a new quiet spell.
+  // A half duplex loop's echo of our last char can come after TX is done.
+  if (printing && !sched_pending() && !flag_tx_ready) {
+    printing = 0;
+    done_ms = now;
+  }
+  n = stats.rx_chars + stats.tx_chars;
+  if (n != loop_chars) {
+    loop_chars = n;
+    if (!printing && (now - done_ms >= SCHED_ECHO_WAIT))
+      idle_done = 0;
+    active_ms = now;
+  }
+  if (flag_tx_ready)
+    active_ms = now;
+  if (stats.usb_out_bytes != host_chars) {
+    host_chars = stats.usb_out_bytes;
+    host_ms = now;
+  }
+
+  if (sched_every && (now - every_ms >= (uint32_t)sched_every * 60000)) {
+    every_ms += (uint32_t)sched_every * 60000;
+    due = 1;
+  }
+  if (sched_idle && !idle_done &&
+      (now - active_ms >= (uint32_t)sched_idle * 1000)) {
+    idle_done = 1;
+    due = 1;
+  }
+  if (!due || msg_at || !(confflags & CONF_TRANSLATE) || !lineout_idle())
+    return;
+  if (column && (now - host_ms < SCHED_LINE_WAIT))
+    return;
+
+  due = 0;
+  msg_at = EEP_AUTOMSG_START;
+  if (msg_char() == 0xFF) { // no message saved
+    msg_at = 0;
+    return;
+  }
+  msg_lead = column ? 2 : 0;
+  printing = 1;
+  shift_forget(); // someone may have left it in FIGS
+  stats.scheduled++;
+}
+
+// TRUE while there's more of the message for sched_next()
+uint8_t sched_pending(void) { return msg_at || msg_lead || msg_lf; }
+
+char sched_next(void) {
+  char c;
+
+  if (msg_lead)
+    return (--msg_lead) ? '\r' : '\n';
+  if (msg_lf) {
+    msg_lf = 0;
+    return '\n';
+  }
+  if (!msg_at)
+    return 0;
+  c = msg_char();
+  msg_at++;
+  if (msg_char() == 0xFF)
+    msg_at = 0; // that was the last one
+  if (c == '\r')
+    msg_lf = 1;
+  return c;
+}
+#endif
@@ -0,0 +1,13 @@
+// Printing the autoprint message on a timer, between lines of host text.
+// See sched.c.
+
+#define SCHED_LINE_WAIT 10000 // ms of host silence before breaking a line
+#define SCHED_ECHO_WAIT 1000  // ms after printing that loop traffic is ours
+
+extern uint16_t sched_every; // minutes, 0 = off
+extern uint16_t sched_idle;  // seconds, 0 = off
+
+void sched_restart(void);
+void sched_task(void);
+uint8_t sched_pending(void);
+char sched_next(void);
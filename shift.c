@@ -0,0 +1,87 @@
+/* Keeping baudot_shift_send honest.
+ *
+ * The sender only ever knows the machine's shift from what it sent last.
+ * After a break, someone typing on the machine, a power cycle or just a
+ * long pause that can be wrong, and everything up to the next shift prints
+ * in the other case. So the sender can forget (SHIFT_UNKNOWN), and then the
+ * next char that needs a shift gets one whichever case it's in. Chars that
+ * are the same in both cases (space, CR, LF) don't need one either way.
+ *
+ * When to forget is up to resync: after a break sent or received, after
+ * every CR, after resync_chars printing chars in a row without a shift, or
+ * after resync_idle seconds of not sending.
+ *
+ * On a half duplex loop (CONF_HALFDUPLEX) the receiver hears the machine's
+ * own keyboard too. A shift that came from there, rather than being the echo
+ * of one we sent, tells us what case the machine is in now. */
+
+#include "shift.h"
+#include "baudot.h"
+#include "conf.h"
+#include "profile.h"
+#include "softuart.h"
+#include "stats.h"
+#include "tick.h"
+
+extern uint16_t confflags;                   // from main.c
+extern uint8_t baudot_shift_send;            // from baudot.c
+extern uint8_t baudot_shift_rcv;             // from baudot.c
+extern volatile unsigned char flag_tx_ready; // from softuart.c
+
+uint8_t resync = RESYNC_BREAK;
+uint8_t resync_chars = 0;
+uint16_t resync_idle = 0;
+
+static uint8_t unshifted = 0; // printing chars since the last shift
+static uint32_t sent_ms;      // last time anything went out
+
+void shift_forget(void) {
+  if (baudot_shift_send != SHIFT_UNKNOWN)
+    stats.resyncs++;
+  baudot_shift_send = SHIFT_UNKNOWN;
+  unshifted = 0;
+}
+
+// tty_putchar() sent code, shift or not
+void shift_sent(uint8_t code) {
+  sent_ms = millis();
+  if (profile_shift(code)) {
+    unshifted = 0;
+    return;
+  }
+  if ((profile_char(code) == '\r') && (resync & RESYNC_LINE)) {
+    shift_forget();
+    return;
+  }
+  if (resync_chars && (++unshifted >= resync_chars))
+    shift_forget();
+}
+
+// The receiver just decoded code (baudot_shift_rcv is up to date). Only
+// frames that aren't our own echo say anything new.
+void shift_heard(uint8_t code, uint8_t flags) {
+  if (!(confflags & CONF_HALFDUPLEX) ||
+      (flags & (SOFTUART_ECHO | SOFTUART_COLLISION | SOFTUART_FE |
+                SOFTUART_BREAK)))
+    return;
+  if (profile_shift(code) ||
+      ((profile_char(code) == ' ') && (confflags & CONF_UNSHIFT_ON_SPACE))) {
+    if (baudot_shift_send != baudot_shift_rcv)
+      stats.heard_shifts++;
+    baudot_shift_send = baudot_shift_rcv;
+    unshifted = 0;
+  }
+}
+
+void shift_break(void) {
+  if (resync & RESYNC_BREAK)
+    shift_forget();
+}
+
+void shift_task(void) {
+  if (flag_tx_ready)
+    sent_ms = millis(); // still going out
+  else if (resync_idle && (baudot_shift_send != SHIFT_UNKNOWN) &&
+           (millis() - sent_ms >= (uint32_t)resync_idle * 1000))
+    shift_forget();
+}
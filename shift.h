@@ -0,0 +1,19 @@
+// Which shift the machine is in, as far as the sender knows. See shift.c.
+
+#define SHIFT_UNKNOWN 0 // baudot_shift_send when we don't know
+
+// resync flags
+#define RESYNC_BREAK (1 << 0) // after a break either way
+#define RESYNC_LINE (1 << 1)  // after every CR
+
+#define RESYNC_MAXIDLE 3600 // s
+
+extern uint8_t resync;       // RESYNC_
+extern uint8_t resync_chars; // printing chars without a shift, 0 = off
+extern uint16_t resync_idle; // s without sending, 0 = off
+
+void shift_forget(void);
+void shift_sent(uint8_t code);
+void shift_heard(uint8_t code, uint8_t flags);
+void shift_break(void);
+void shift_task(void);
@@ -0,0 +1,908 @@
+/* Behaviour checks on top of the simulator in sim.c. Where fuzz.c throws
+ * random traffic at translation and framing, these are fixed scripts, one
+ * per feature: each powers up the firmware in its own process, with the
+ * eeprom the way a unit in the field would have it, drives it through
+ * commands and the host and the loop, and checks what comes out.
+ *
+ *   make -C sim && sim/checks            (all of them)
+ *   sim/checks boot-blank boot-legacy    (just those)
+ */
+
+#include "sim.h"
+#include <avr/eeprom.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <util/crc16.h>
+
+#include "../cmdline.h"
+#include "../conf.h"
+#include "../config.h"
+#include "../main.h"
+#include "../profile.h"
+#include "../rxout.h"
+#include "../sched.h"
+#include "../spool.h"
+#include "../stats.h"
+#include "../tick.h"
+
+#define BOOT_LOAD 0 // from main.c
+#define BOOT_DONE 2
+extern uint8_t boot_state;
+extern uint16_t confflags;
+extern volatile uint8_t rxbits;
+
+#define LTRS 0x1F
+#define FIGS 0x1B
+
+static const char ltrs[32] = {0,    'E', 0x0A, 'A', ' ', 'S', 'I', 'U',
+                              0x0D, 'D', 'R',  'J', 'N', 'F', 'C', 'K',
+                              'T',  'Z', 'L',  'W', 'H', 'Y', 'P', 'Q',
+                              'O',  'B', 'G',  0,   'M', 'X', 'V', 0};
+
+static const char figs[32] = {0,    '3', 0x0A, '-', ' ', '\'', '8', '7',
+                              0x0D, 0x05, '4', 0x07, ',', '$', ':',  '(',
+                              '5',  '+', ')',  '2', '#', '6',  '0', '1',
+                              '9',  '?', '&',  0,   '.', '/', '=',  0};
+
+// give up on a check that hasn't finished in this much simulated time
+#define CHECK_LIMIT (120 * 1000 * SIM_MS)
+
+struct check {
+  const char *name;
+  void (*reset)(void); // the eeprom at power up, NULL for a new chip
+  void (*run)(void);   // the script, see step
+};
+
+static const struct check *check;
+static int failures;
+
+// A script is a switch on step, called once per pass of the main loop
+// after boot. next() moves on, waited() is how long this step has been
+// going.
+static int step;
+static sim_time_t step_at;
+
+static void next(void) {
+  step++;
+  step_at = sim_now;
+}
+
+static int waited(long ms) { return sim_now - step_at >= ms * SIM_MS; }
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+
+  failures++;
+  fprintf(sim_out, "  %s: ", check->name);
+  va_start(ap, fmt);
+  vfprintf(sim_out, fmt, ap);
+  va_end(ap);
+  fprintf(sim_out, "\n");
+}
+
+static void done(void) {
+  printf("%-16s %s\n", check->name, failures ? "FAIL" : "ok");
+  fflush(sim_out);
+  _exit(failures ? 2 : 0);
+}
+
+// what the adapter sent the host
+static char usb[65536];
+static size_t nusb;
+
+void model_usb_in(uint8_t c) {
+  if (nusb < sizeof(usb) - 1)
+    usb[nusb++] = c;
+}
+
+void model_usb_take(size_t i) {}
+
+static const char *usb_from(size_t from) {
+  usb[nusb] = 0;
+  return usb + from;
+}
+
+// Run a command as if typed at the command line, and return what it
+// printed. The main loop doesn't go on meanwhile, but USB does.
+static const char *cmd(const char *line) {
+  char buf[CMDBUFLEN];
+  size_t from = nusb;
+
+  strncpy(buf, line, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = 0;
+  if (!cmd_execute(buf))
+    fail("no such command: %s", line);
+  return usb_from(from);
+}
+
+static void expect(const char *what, const char *got, const char *want) {
+  if (!strstr(got, want))
+    fail("%s: wanted \"%s\" in \"%s\"", what, want, got);
+}
+
+// The wire decoder, as in fuzz.c but at whatever speed and width the
+// adapter has now. 5 bit codes are decoded with the shifts they carry into
+// text, with the time each char's stop bit ended.
+static struct {
+  int line; // adapter TX, 1 = mark
+  int busy;
+  sim_time_t t0, bit, next;
+  int k, nbits;
+  unsigned code;
+  int figs;
+} wd = {1};
+
+#define WIRE 8192
+static char wire[WIRE];
+static sim_time_t wire_t[WIRE];
+static size_t nwire;
+
+static void wire_char(unsigned code) {
+  char c;
+
+  if (code == LTRS) {
+    wd.figs = 0;
+    return;
+  }
+  if (code == FIGS) {
+    wd.figs = 1;
+    return;
+  }
+  c = (wd.nbits != 5) ? code : wd.figs ? figs[code] : ltrs[code];
+  if (!c || (nwire >= WIRE - 1))
+    return;
+  wire_t[nwire] = sim_now;
+  wire[nwire++] = c;
+  wire[nwire] = 0;
+}
+
+void model_tx(int mark) {
+  wd.line = mark;
+  if (mark || wd.busy)
+    return;
+  wd.busy = 1;
+  wd.t0 = sim_now;
+  wd.bit = 3LL * (OCR1A + 1) * 4000; // Timer1 runs at 3x baud, 4us a count
+  wd.nbits = rxbits;
+  wd.k = 1;
+  wd.code = 0;
+  wd.next = wd.t0 + wd.bit + wd.bit / 2;
+}
+
+// Frames typed on the loop, as edges for the RX pin, at the adapter's
+// speed with two stop bits. Nothing the adapter sends comes back.
+#define RXQ 16384
+static struct {
+  sim_time_t t;
+  int mark;
+} rxq[RXQ];
+static int rxq_in, rxq_out;
+static sim_time_t rxq_at; // end of the last stop bit queued
+static int rx_figs;
+
+static void rx_edge(int mark, sim_time_t len) {
+  rxq[rxq_in].t = rxq_at;
+  rxq[rxq_in].mark = mark;
+  rxq_in = (rxq_in + 1) % RXQ;
+  rxq_at += len;
+}
+
+static void rx_code(unsigned code) {
+  sim_time_t bit = 3LL * (OCR1A + 1) * 4000;
+  int i;
+
+  if (rxq_at < sim_now)
+    rxq_at = sim_now;
+  rx_edge(0, bit);
+  for (i = 0; i < 5; i++)
+    rx_edge((code >> i) & 1, bit);
+  rx_edge(1, 2 * bit);
+}
+
+// type s on the loop in ITA2, shifting as needed
+static void loop_type(const char *s) {
+  const char *p;
+
+  for (; *s; s++) {
+    if ((p = memchr(rx_figs ? figs : ltrs, *s, 32)) != NULL) {
+      rx_code(p - (rx_figs ? figs : ltrs));
+      continue;
+    }
+    rx_figs = !rx_figs;
+    rx_code(rx_figs ? FIGS : LTRS);
+    if ((p = memchr(rx_figs ? figs : ltrs, *s, 32)) != NULL)
+      rx_code(p - (rx_figs ? figs : ltrs));
+  }
+}
+
+// TRUE once all of it has been received
+static int typed(void) {
+  return (rxq_out == rxq_in) && (sim_now >= rxq_at + 50 * SIM_MS);
+}
+
+sim_time_t model_next(void) {
+  sim_time_t t = wd.busy ? wd.next : SIM_NEVER;
+
+  if ((rxq_out != rxq_in) && (rxq[rxq_out].t < t))
+    t = rxq[rxq_out].t;
+  return t;
+}
+
+void model_event(void) {
+  while ((rxq_out != rxq_in) && (rxq[rxq_out].t <= sim_now)) {
+    sim_rx(rxq[rxq_out].mark);
+    rxq_out = (rxq_out + 1) % RXQ;
+  }
+  if (!wd.busy || (wd.next > sim_now))
+    return;
+  if (wd.k <= wd.nbits) {
+    if (wd.line)
+      wd.code |= 1 << (wd.k - 1);
+    wd.k++;
+    wd.next = wd.t0 + wd.k * wd.bit +
+              ((wd.k <= wd.nbits) ? wd.bit / 2 : wd.bit / 4);
+    return;
+  }
+  wd.busy = 0;
+  if (!wd.line)
+    fail("framing error on the wire");
+  wire_char(wd.code);
+}
+
+// where want is in the wire text from from on, or -1
+static long wire_find(size_t from, const char *want) {
+  const char *p = strstr(wire + from, want);
+  return p ? p - wire : -1;
+}
+
+// a readable copy of s, for messages
+static const char *show(const char *s) {
+  static char buf[4][512];
+  static int k;
+  char *b = buf[k++ % 4];
+  size_t n = 0;
+
+  for (; *s && (n < sizeof(buf[0]) - 3); s++) {
+    if ((*s == '\r') || (*s == '\n')) {
+      b[n++] = '\\';
+      b[n++] = (*s == '\r') ? 'r' : 'n';
+    } else
+      b[n++] = *s;
+  }
+  b[n] = 0;
+  return b;
+}
+
+static uint8_t eep(uint16_t addr) {
+  return eeprom_read_byte((const uint8_t *)(uintptr_t)addr);
+}
+
+// table n in eeprom holds flash table f
+static int table_is(uint8_t n, uint8_t f) {
+  uint8_t i;
+
+  for (i = 0; i < EEP_TABLE_SIZE; i++)
+    if (eep(EEP_TABLES_START + n * EEP_TABLE_SIZE + i) != table_flash[f][i])
+      return 0;
+  return 1;
+}
+
+/* Boot, and the eeprom left by older firmware */
+
+// a new chip gets the default table and settings, saved
+static void boot_blank(void) {
+  struct config c;
+
+  if (!table_is(0, 0))
+    fail("table 0 isn't the default");
+  if (!config_read(&c))
+    fail("no settings saved");
+  if ((confflags != (CONF_TRANSLATE | CONF_CRLF)) || (OCR1A != 1667))
+    fail("flags %04x divisor %u, not the defaults", confflags, OCR1A);
+  done();
+}
+
+// someone loaded table 0 and never saved the settings
+static void boot_table_reset(void) {
+  uint8_t i;
+
+  for (i = 0; i < EEP_TABLE_SIZE; i++)
+    eeprom_write_byte((uint8_t *)(EEP_TABLES_START + i), table_flash[1][i]);
+}
+
+static void boot_table(void) {
+  struct config c;
+
+  if (!table_is(0, 1))
+    fail("table 0 was overwritten");
+  if (!config_read(&c) || (confflags != (CONF_TRANSLATE | CONF_CRLF)))
+    fail("defaults not saved");
+  done();
+}
+
+// settings at the old fixed offsets: 50 baud, crlf and translate, table 1
+static void boot_legacy_reset(void) {
+  eeprom_write_word((uint16_t *)EEP_LEGACY_CONFIGURED_LOCATION,
+                    EEP_LEGACY_CONFIGURED_MAGIC);
+  eeprom_write_word((uint16_t *)EEP_LEGACY_BAUDDIV_LOCATION, 757);
+  eeprom_write_byte((uint8_t *)EEP_LEGACY_CONFFLAGS_LOCATION,
+                    CONF_CRLF | CONF_TRANSLATE);
+  eeprom_write_byte((uint8_t *)EEP_LEGACY_TABLE_SELECT_LOCATION, 1);
+  boot_table_reset();
+}
+
+static void boot_legacy_same(const char *when) {
+  if ((confflags != (CONF_CRLF | CONF_TRANSLATE)) || (OCR1A != 757) ||
+      (profile_table[0] != 1))
+    fail("%s: flags %04x divisor %u table %u", when, confflags, OCR1A,
+         profile_table[0]);
+  if (!table_is(0, 1))
+    fail("%s: table 0 was overwritten", when);
+}
+
+static void boot_legacy(void) {
+  struct config c;
+
+  switch (step) {
+  case 0:
+    boot_legacy_same("migrated");
+    cmd("save");
+    // and power up again
+    boot_state = BOOT_LOAD;
+    next();
+    break;
+  case 1:
+    boot_legacy_same("saved");
+    if (eep(EEP_LEGACY_CONFIGURED_LOCATION) == 0x45)
+      fail("legacy settings still there after save");
+    if (!config_read(&c))
+      fail("nothing saved");
+    done();
+  }
+}
+
+/* Tables over the command line, tget/tput */
+
+// t as tput wants it, see cmdline.c
+static char *table_text(const char *t, uint8_t size) {
+  static char s[1024];
+  uint16_t crc = 0xFFFF;
+  size_t n = 0;
+  uint8_t i;
+
+  for (i = 0; i < size; i++) {
+    if (!(i % 32))
+      n += sprintf(s + n, ":%02X", i);
+    n += sprintf(s + n, "%02X", (uint8_t)t[i]);
+    if ((i % 32) == 31)
+      n += sprintf(s + n, "\r\n");
+    crc = _crc_ccitt_update(crc, t[i]);
+  }
+  sprintf(s + n, ".%04X\r\n", crc);
+  return s;
+}
+
+static const char *tput(uint8_t n, const char *t) {
+  char line[16];
+  const char *s = table_text(t, EEP_TABLE_SIZE);
+
+  sim_host_write(s, strlen(s));
+  sprintf(line, "tput %u", n);
+  return cmd(line);
+}
+
+// a 5 bit table whose first byte is blank, as a fresh table reads
+static void table_blank(void) {
+  char t[EEP_TABLE_SIZE], line[16];
+
+  memcpy(t, table_flash[1], sizeof(t));
+  t[0] = 0xFF;
+  expect("tput", tput(2, t), "Table 2 written");
+  if ((eep(EEP_TABLES_START + 2 * EEP_TABLE_SIZE) != 0xFF) ||
+      (eep(EEP_TABLES_START + 3 * EEP_TABLE_SIZE - 1) != (uint8_t)t[63]))
+    fail("table 2 not in eeprom");
+  expect("tget", cmd("tget 2"), table_text(t, sizeof(t)));
+  cmd("profile 1 2");
+  if ((profile_table[1] != 2) || (profile_width[1] != 5))
+    fail("profile 1 has table %u, %u bits", profile_table[1],
+         profile_width[1]);
+  cmd("profile 0");
+
+  // no such width
+  t[0] = 4;
+  expect("width 4", tput(3, t), "Rejected at byte 0: width must be");
+  if (eep(EEP_TABLES_START + 3 * EEP_TABLE_SIZE) != 0xFF)
+    fail("table 3 written anyway");
+  sprintf(line, "tput %u", TABLES_EEP);
+  expect("flash", cmd(line), "is in flash");
+  done();
+}
+
+/* The scheduled message, sched.c */
+
+// longer than the TX queue, so it doesn't all go in at once
+#define SCHED_MSG "DE W1AW W1AW W1AW QTH NEWINGTON CT\r"
+
+static void sched_reset(void) {
+  eeprom_write_block(SCHED_MSG, (void *)EEP_AUTOMSG_START, strlen(SCHED_MSG));
+  eeprom_write_byte((uint8_t *)EEP_AUTOMSG_START + strlen(SCHED_MSG), 0xFF);
+}
+
+// "sched every 1" while the host keeps sending lines: the message comes a
+// minute in, between two of them
+#define SCHED_LINE "THE QUICK BROWN FOX\r"
+
+static void sched_every_check(void) {
+  static sim_time_t t;
+  long at;
+
+  switch (step) {
+  case 0:
+    cmd("sched every 1");
+    t = sim_now;
+    next();
+    break;
+  case 1:
+    if (!sim_host_pending())
+      sim_host_write(SCHED_LINE, strlen(SCHED_LINE));
+    if ((at = wire_find(0, "DE")) < 0)
+      break;
+    if ((wire_t[at] - t < 60000 * SIM_MS) || (wire_t[at] - t > 65000 * SIM_MS))
+      fail("message %.1f s in", (double)(wire_t[at] - t) / 1e9);
+    next();
+    break;
+  case 2:
+    if (!waited(10000))
+      break;
+    if (wire_find(0, "FOX\r\n" SCHED_MSG "\nTHE QUICK") < 0)
+      fail("not between lines: %s", show(wire + wire_find(0, "DE") - 30));
+    done();
+  }
+}
+
+// "sched idle 2": a line the host left unfinished gets SCHED_LINE_WAIT ms
+// before the message breaks it, then there's one message per quiet spell
+static void sched_idle_check(void) {
+  static sim_time_t t;
+  long at;
+
+  switch (step) {
+  case 0:
+    cmd("sched idle 2");
+    sim_host_write("HELLO", 5);
+    t = sim_now;
+    next();
+    break;
+  case 1:
+    if ((at = wire_find(0, "DE")) < 0)
+      break;
+    if (wire_t[at] - t < SCHED_LINE_WAIT * SIM_MS)
+      fail("broke the line after %.1f s", (double)(wire_t[at] - t) / 1e9);
+    next();
+    break;
+  case 2:
+    if (!waited(8000))
+      break;
+    if (strcmp(wire, "HELLO\r\n" SCHED_MSG "\n"))
+      fail("first: %s", show(wire));
+    sim_host_write("MORE\r", 5);
+    next();
+    break;
+  case 3:
+    if ((at = wire_find(strlen("HELLO\r\n" SCHED_MSG "\n"), "DE")) < 0)
+      break;
+    if (wire_t[at] - wire_t[at - 1] < 2000 * SIM_MS)
+      fail("not idle for 2 s: %.1f s",
+           (double)(wire_t[at] - wire_t[at - 1]) / 1e9);
+    next();
+    break;
+  case 4:
+    if (!waited(10000))
+      break;
+    if (strcmp(wire, "HELLO\r\n" SCHED_MSG "\nMORE\r\n" SCHED_MSG "\n"))
+      fail("second: %s", show(wire));
+    done();
+  }
+}
+
+/* The spool, spool.c, and the inline escape, escape.c */
+
+// what the host sends, and what it should come out as with crlf
+static char host_text[1024], host_wire[2048];
+
+static void host_lines(int n) {
+  size_t a = 0, b = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    a += sprintf(host_text + a, "NOW IS THE TIME %02d\r", i);
+    b += sprintf(host_wire + b, "NOW IS THE TIME %02d\r\n", i);
+  }
+}
+
+// an autoprint message of len chars
+static void spool_msg(uint16_t len) {
+  uint16_t i;
+
+  for (i = 0; i < len; i++)
+    eeprom_write_byte((uint8_t *)EEP_AUTOMSG_START + i, 'A' + i % 26);
+  eeprom_write_byte((uint8_t *)EEP_AUTOMSG_START + len, 0xFF);
+}
+
+static void spool_msg_same(uint16_t len) {
+  uint16_t i;
+
+  for (i = 0; i < len; i++)
+    if (eep(EEP_AUTOMSG_START + i) != 'A' + i % 26)
+      break;
+  if ((i < len) || (eep(EEP_AUTOMSG_START + len) != 0xFF))
+    fail("autoprint message changed at %u", i);
+}
+
+static void spool_short_reset(void) { spool_msg(20); }
+
+// a message that runs into the spool's eeprom overflow
+#define SPOOL_LONG (EEP_SPOOL_START - EEP_AUTOMSG_START + 10)
+static void spool_long_reset(void) { spool_msg(SPOOL_LONG); }
+
+// Open the loop, have the host send more than fits in RAM, close it again:
+// it all has to come out in order, with the overflow in the eeprom if the
+// message leaves it free, or the host held off if not.
+static void spool_check(void) {
+  static size_t mark;
+  uint16_t len = strlen(host_text);
+  uint16_t room = (check->reset == spool_long_reset) ? SPOOL_RAM : len;
+  uint16_t i;
+
+  switch (step) {
+  case 0:
+    host_lines(16);
+    cmd("spool");
+    sim_rx(0);
+    next();
+    break;
+  case 1:
+    if (!waited(SPOOL_OPEN_MS + 1000))
+      break;
+    mark = nwire;
+    sim_host_write(host_text, len);
+    next();
+    break;
+  case 2:
+    if (!waited(3000))
+      break;
+    if (nwire != mark)
+      fail("sent into an open loop: %s", show(wire + mark));
+    if ((spool_len() != room) || (sim_host_pending() != (size_t)(len - room)) ||
+        stats.spool_lost)
+      fail("spooled %u, host has %zu, lost %u", spool_len(),
+           sim_host_pending(), stats.spool_lost);
+    if (room == len)
+      for (i = SPOOL_RAM; i < len; i++)
+        if (eep(EEP_SPOOL_START + i - SPOOL_RAM) != host_text[i]) {
+          fail("not in the eeprom");
+          break;
+        }
+    spool_msg_same((room == len) ? 20 : SPOOL_LONG);
+    sim_rx(1);
+    next();
+    break;
+  case 3:
+    if (sim_host_pending() || spool_len() || !waited(5000) ||
+        (sim_now - wire_t[nwire - 1] < 5000 * SIM_MS))
+      break;
+    if (strcmp(wire + mark, host_wire))
+      fail("came out as %s", show(wire + mark));
+    done();
+  }
+}
+
+// Escape chars that turn out to be data go on to the loop in order, and
+// not into the middle of a scheduled message that started meanwhile.
+static void escape_check(void) {
+  static sim_time_t t;
+  static size_t mark;
+
+  switch (step) {
+  case 0:
+    cmd("guard 500");
+    cmd("sched every 1");
+    t = sim_now;
+    next();
+    break;
+  case 1:
+    if (!waited(1000))
+      break;
+    sim_host_write("X+", 2);
+    next();
+    break;
+  case 2:
+    if (!waited(1000))
+      break;
+    sim_host_write("++AB", 4);
+    next();
+    break;
+  case 3:
+    if (!waited(1000))
+      break;
+    sim_host_write("++\r", 3);
+    next();
+    break;
+  case 4:
+    if (!waited(3000))
+      break;
+    if (strcmp(wire, "X+++AB++\r\n"))
+      fail("came out as %s", show(wire));
+    next();
+    break;
+  case 5:
+    // the guard time runs out while the message is going out
+    if (sim_now - t < 60000 * SIM_MS - 200 * SIM_MS)
+      break;
+    mark = nwire;
+    sim_host_write("+", 1);
+    next();
+    break;
+  case 6:
+    if (!waited(10000))
+      break;
+    if (strcmp(wire + mark, SCHED_MSG "\n+"))
+      fail("came out as %s", show(wire + mark));
+    done();
+  }
+}
+
+/* Received text a line at a time, rxout.c */
+
+// Line mode holds text until the line ends, or the loop has been quiet
+// RXOUT_LINE_WAIT ms, and a line end is always CR LF.
+static void rx_line_check(void) {
+  static size_t mark;
+
+  switch (step) {
+  case 0:
+    cmd("rxmode line");
+    mark = nusb;
+    loop_type("HELLO WORLD");
+    next();
+    break;
+  case 1:
+    if (!typed())
+      break;
+    if (nusb != mark)
+      fail("sent before the line ended: %s", show(usb_from(mark)));
+    loop_type("\r\n");
+    next();
+    break;
+  case 2:
+    if (!typed())
+      break;
+    if (strcmp(usb_from(mark), "HELLO WORLD\r\n"))
+      fail("line: %s", show(usb_from(mark)));
+    mark = nusb;
+    loop_type("PARTIAL");
+    next();
+    break;
+  case 3:
+    if (typed())
+      next();
+    break;
+  case 4:
+    if (!waited(RXOUT_LINE_WAIT - 500))
+      break;
+    if (nusb != mark)
+      fail("sent before RXOUT_LINE_WAIT: %s", show(usb_from(mark)));
+    next();
+    break;
+  case 5:
+    if (!waited(1000))
+      break;
+    if (strcmp(usb_from(mark), "PARTIAL"))
+      fail("after RXOUT_LINE_WAIT: %s", show(usb_from(mark)));
+    loop_type(" REST\r\n\n");
+    next();
+    break;
+  case 6:
+    if (!typed())
+      break;
+    if (strcmp(usb_from(mark), "PARTIAL REST\r\n\r\n"))
+      fail("rest and a blank line: %s", show(usb_from(mark)));
+    done();
+  }
+}
+
+// the record at *at, with these flags and text, and its time stamp
+static uint32_t record(size_t *at, uint8_t flags, const char *text) {
+  const uint8_t *r = (const uint8_t *)usb + *at;
+  size_t len = strlen(text);
+
+  if ((*at + LINE_HDRLEN > nusb) || (r[0] != LINE_SYNC) || (r[1] != flags) ||
+      (r[2] != len) || (*at + LINE_HDRLEN + len > nusb) ||
+      memcmp(r + LINE_HDRLEN, text, len)) {
+    fail("wanted a record of %u, %s at %zu", flags, show(text), *at);
+    *at = nusb;
+    return 0;
+  }
+  *at += LINE_HDRLEN + len;
+  return r[3] | (r[4] << 8) | ((uint32_t)r[5] << 16);
+}
+
+// Record mode: a header with the length and when the line started, no line
+// end, and a line over RXOUT_LINE split with LINE_MORE.
+static void rx_record_check(void) {
+  static size_t mark;
+  static uint32_t t;
+  static char text[128];
+  char part[RXOUT_LINE + 1];
+  uint32_t ms, ms2;
+  int i, n = 0;
+
+  switch (step) {
+  case 0:
+    cmd("rxmode record");
+    mark = nusb;
+    t = millis();
+    loop_type("SHORT LINE\r\n");
+    next();
+    break;
+  case 1:
+    if (!typed())
+      break;
+    ms = record(&mark, 0, "SHORT LINE");
+    if ((ms < t) || (ms > t + 500))
+      fail("stamped %u, typing started at %u", ms, t);
+    if (mark != nusb)
+      fail("more after it: %s", show(usb_from(mark)));
+    for (i = 0; i < 5; i++)
+      n += sprintf(text + n, "NOW IS THE TIME %02d ", i);
+    strcpy(text + n, "ABCDE");
+    loop_type(text);
+    loop_type("\r\n\n");
+    next();
+    break;
+  case 2:
+    if (!typed())
+      break;
+    memcpy(part, text, RXOUT_LINE);
+    part[RXOUT_LINE] = 0;
+    ms = record(&mark, LINE_MORE, part);
+    ms2 = record(&mark, 0, text + RXOUT_LINE);
+    if (ms2 <= ms)
+      fail("the rest stamped %u, the start %u", ms2, ms);
+    record(&mark, 0, "");
+    loop_type("ABC");
+    next();
+    break;
+  case 3:
+    if (typed())
+      next();
+    break;
+  case 4:
+    if (!waited(RXOUT_LINE_WAIT + 500))
+      break;
+    record(&mark, LINE_MORE, "ABC");
+    done();
+  }
+}
+
+// Record mode is for a capdecode session, it's saved as line mode, and
+// one saved by older firmware comes back as line mode too.
+static void rx_saved_check(void) {
+  struct config c;
+
+  switch (step) {
+  case 0:
+    cmd("rxmode record");
+    cmd("save");
+    boot_state = BOOT_LOAD;
+    next();
+    break;
+  case 1:
+    if (rxmode != RXMODE_LINE)
+      fail("booted into rxmode %u", rxmode);
+    if (!config_read(&c) || (c.rxmode != RXMODE_LINE))
+      fail("saved rxmode %u", c.rxmode);
+    c.rxmode = RXMODE_RECORD;
+    config_write(&c);
+    boot_state = BOOT_LOAD;
+    next();
+    break;
+  case 2:
+    if (rxmode != RXMODE_LINE)
+      fail("booted into saved rxmode %u", rxmode);
+    done();
+  }
+}
+
+// An idle line in logic mode still reaches the host every LA_RUN_WAIT ms,
+// as all mark runs, not once 255 bytes of samples have piled up.
+static void rx_logic_check(void) {
+  static size_t mark;
+  size_t i;
+  int runs = 0;
+
+  switch (step) {
+  case 0:
+    cmd("rxmode logic");
+    mark = nusb;
+    next();
+    break;
+  case 1:
+    if (!waited(3 * LA_RUN_WAIT + 500))
+      break;
+    for (i = mark; i + 1 < nusb; i += 2, runs++)
+      if (((uint8_t)usb[i] != 0xFF) || !usb[i + 1])
+        fail("not an idle run at %zu", i - mark);
+    if ((runs < 3) || (i != nusb))
+      fail("%d runs, %zu bytes", runs, nusb - mark);
+    done();
+  }
+}
+
+static const struct check checks[] = {
+    {"boot-blank", NULL, boot_blank},
+    {"boot-table", boot_table_reset, boot_table},
+    {"boot-legacy", boot_legacy_reset, boot_legacy},
+    {"table-blank", NULL, table_blank},
+    {"sched-every", sched_reset, sched_every_check},
+    {"sched-idle", sched_reset, sched_idle_check},
+    {"spool-eeprom", spool_short_reset, spool_check},
+    {"spool-ram", spool_long_reset, spool_check},
+    {"escape-data", sched_reset, escape_check},
+    {"rx-line", NULL, rx_line_check},
+    {"rx-record", NULL, rx_record_check},
+    {"rx-saved", NULL, rx_saved_check},
+    {"rx-logic", NULL, rx_logic_check},
+};
+#define NCHECKS (sizeof(checks) / sizeof(checks[0]))
+
+void model_reset(void) {
+  if (check->reset)
+    check->reset();
+}
+
+void model_task(void) {
+  static int busy;
+
+  if (sim_now > CHECK_LIMIT) {
+    fail("timed out in step %d", step);
+    done();
+  }
+  // commands in a script go through USB, which comes back here
+  if (busy || (boot_state != BOOT_DONE))
+    return;
+  busy = 1;
+  check->run();
+  busy = 0;
+}
+
+int main(int argc, char **argv) {
+  int i, j, n = 0, failed = 0, status;
+  pid_t pid;
+
+  for (i = 0; i < (int)NCHECKS; i++) {
+    for (j = 1; j < argc; j++)
+      if (!strcmp(argv[j], checks[i].name))
+        break;
+    if ((argc > 1) && (j == argc))
+      continue;
+    // each in its own process, so the firmware starts from reset
+    n++;
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      check = &checks[i];
+      firmware_main();
+      _exit(1);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+      failed++;
+  }
+  printf("%d checks, %d failed\n", n, failed);
+  return failed ? 1 : 0;
+}
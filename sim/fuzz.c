@@ -0,0 +1,730 @@
+/* Randomized round trip tests for translation and framing, on top of the
+ * simulator in sim.c. Each run boots the firmware with a random setup
+ * (translate with random crlf/autocr/wordwrap/usos/width/fill, raw Baudot or
+ * 8 bit, any of the standard speeds), has the host send random text or
+ * bytes, and loops the adapter's TX straight back to its RX, with a little
+ * delay and jitter. Then it checks:
+ *
+ *  - every frame the adapter sends is well formed: a full stop bit before
+ *    the next start
+ *  - decoding the frames on the wire, with the shifts they carry, gives
+ *    back exactly the host's printable chars (those with Baudot codes) in
+ *    order, or exactly the host's bytes in raw and 8 bit mode. With utf8,
+ *    the text has some UTF-8 in it too, which has to come out transliterated
+ *  - the adapter's idea of the shift it sent (baudot_shift_send) and
+ *    received (baudot_shift_rcv) matches the wire once it's quiet, or for
+ *    the sender, it knows that it doesn't know (SHIFT_UNKNOWN)
+ *  - the echo the host gets back matches the wire, with no framing errors
+ *    or overruns, or with dropecho there's none at all
+ *  - in some halfduplex runs someone types one frame over ours; then every
+ *    frame sent has to come back as itself or be counted as a collision
+ *  - after a burst of line noise (glitches, runts, breaks) the receiver
+ *    picks up clean frames, sent at a slightly wrong speed, and decodes
+ *    them right as soon as they carry a shift. With halfduplex, those count
+ *    as the machine's keyboard, and the sender has to follow their shifts
+ *
+ * Failing runs print the seed, "fuzz -r seed -v" repeats one with the
+ * details. Every run also reports its throughput.
+ *
+ *   make -C sim && sim/fuzz -n 200
+ */
+
+#include "sim.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../conf.h"
+#include "../lineout.h"
+#include "../main.h"
+#include "../profile.h"
+#include "../shift.h"
+#include "../softuart.h"
+#include "../stats.h"
+
+#define BOOT_DONE 2 // from main.c
+extern uint8_t boot_state;
+extern uint16_t confflags;
+extern uint8_t esc_char;
+extern uint8_t baudot_shift_send, baudot_shift_rcv;
+
+#define LTRS 0x1F
+#define FIGS 0x1B
+
+static const char ltrs[32] = {0,    'E', 0x0A, 'A', ' ', 'S', 'I', 'U',
+                              0x0D, 'D', 'R',  'J', 'N', 'F', 'C', 'K',
+                              'T',  'Z', 'L',  'W', 'H', 'Y', 'P', 'Q',
+                              'O',  'B', 'G',  0,   'M', 'X', 'V', 0};
+
+static const char figs[32] = {0,    '3', 0x0A, '-', ' ', '\'', '8', '7',
+                              0x0D, 0x05, '4', 0x07, ',', '$', ':',  '(',
+                              '5',  '+', ')',  '2', '#', '6',  '0', '1',
+                              '9',  '?', '&',  0,   '.', '/', '=',  0};
+
+#define MAXLEN 4096
+
+static int verbose = 0;
+static unsigned long rnd_state;
+
+static unsigned long rnd(void) {
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static unsigned long rnd_n(unsigned long n) { return rnd() % n; }
+
+// this run's setup
+static uint16_t flags;
+static uint16_t divisor;
+static sim_time_t bit;   // one bit on the wire
+static int nbits;        // data bits
+static double jitter;    // RX edge jitter, fraction of a bit
+static uint8_t width, fill_n, fill_cols, fill_kind;
+// someone typing while we send: one frame this many frame times in
+static size_t collide_frame;
+static unsigned collide_code;
+
+static uint8_t input[MAXLEN];
+static size_t input_len;
+
+// frames as they went out on the wire
+static uint8_t wire[4 * MAXLEN];
+static size_t nwire;
+static double min_stop = 99; // shortest stop seen, bits
+static long wire_fe;
+
+// what the host got back; echo_mark is where the noise tail starts
+static uint8_t echo[8 * MAXLEN];
+static size_t necho, echo_mark;
+
+static long failures;
+
+// run state
+#define PH_BOOT 0
+#define PH_STREAM 1
+#define PH_TAIL 2
+static int phase = PH_BOOT;
+static sim_time_t t_begin, t_sent;
+static sim_time_t t_quiet; // last time anything moved on the loop
+static size_t wire_at_quiet;
+static unsigned long run_seed;
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+
+  failures++;
+  if (!verbose && (failures > 1))
+    return;
+  fprintf(sim_out, "    ");
+  va_start(ap, fmt);
+  vfprintf(sim_out, fmt, ap);
+  va_end(ap);
+  fprintf(sim_out, "\n");
+}
+
+// The wire decoder: start on a falling edge, sample each data bit in the
+// middle, the stop a quarter bit in; the stop length is measured at the
+// next start.
+static struct {
+  int line;      // adapter TX, 1 = mark
+  int busy;
+  sim_time_t t0; // start edge
+  sim_time_t next;
+  int k;
+  unsigned code;
+  sim_time_t stop_from; // end of the last frame's data bits
+} wd = {1, 0, 0, 0, 0, 0, -1};
+
+// Injected frames and noise, ANDed with the adapter's TX on the loop
+#define INJ 4096
+static struct {
+  sim_time_t t;
+  int mark;
+} inj[INJ];
+static int inj_in, inj_out;
+static int inj_line = 1;
+
+// edges on their way to the RX pin
+#define RXQ 256
+static struct {
+  sim_time_t t;
+  int mark;
+} rxq[RXQ];
+static int rxq_in, rxq_out;
+static sim_time_t rxq_last;
+static int line_last = 1;
+
+static void line_changed(void) {
+  int mark = wd.line && inj_line;
+  sim_time_t t;
+
+  if (mark == line_last)
+    return;
+  line_last = mark;
+  t = sim_now + 20 * SIM_US +
+      (sim_time_t)(((double)rnd_n(2001) - 1000) / 1000 * jitter * bit);
+  if (t <= rxq_last)
+    t = rxq_last + 1;
+  if (t <= sim_now)
+    t = sim_now + 1;
+  rxq_last = t;
+  rxq[rxq_in].t = t;
+  rxq[rxq_in].mark = mark;
+  rxq_in = (rxq_in + 1) % RXQ;
+}
+
+void model_tx(int mark) {
+  t_quiet = sim_now;
+  wd.line = mark;
+  if (!mark && !wd.busy) {
+    if (wd.stop_from >= 0) {
+      double stop = (double)(sim_now - wd.stop_from) / bit;
+      if (stop < min_stop)
+        min_stop = stop;
+    }
+    wd.busy = 1;
+    wd.t0 = sim_now;
+    wd.k = 1;
+    wd.code = 0;
+    wd.next = wd.t0 + bit + bit / 2;
+  }
+  line_changed();
+}
+
+static void wire_sample(void) {
+  if (wd.k <= nbits) {
+    if (wd.line)
+      wd.code |= 1 << (wd.k - 1);
+    wd.k++;
+    wd.next = wd.t0 + wd.k * bit + ((wd.k <= nbits) ? bit / 2 : bit / 4);
+    return;
+  }
+  if (!wd.line)
+    wire_fe++;
+  wd.busy = 0;
+  wd.stop_from = wd.t0 + (nbits + 1) * bit;
+  if (nwire < sizeof(wire))
+    wire[nwire++] = wd.code;
+}
+
+sim_time_t model_next(void) {
+  sim_time_t t = SIM_NEVER;
+
+  if (rxq_out != rxq_in)
+    t = rxq[rxq_out].t;
+  if ((inj_out != inj_in) && (inj[inj_out].t < t))
+    t = inj[inj_out].t;
+  if (wd.busy && (wd.next < t))
+    t = wd.next;
+  return t;
+}
+
+void model_event(void) {
+  t_quiet = sim_now;
+  while ((inj_out != inj_in) && (inj[inj_out].t <= sim_now)) {
+    inj_line = inj[inj_out].mark;
+    inj_out = (inj_out + 1) % INJ;
+    line_changed();
+  }
+  while ((rxq_out != rxq_in) && (rxq[rxq_out].t <= sim_now)) {
+    sim_rx(rxq[rxq_out].mark);
+    rxq_out = (rxq_out + 1) % RXQ;
+  }
+  if (wd.busy && (wd.next <= sim_now))
+    wire_sample();
+}
+
+void model_usb_take(size_t i) {}
+
+void model_usb_in(uint8_t c) {
+  if (necho < sizeof(echo))
+    echo[necho++] = c;
+}
+
+static sim_time_t inj_at;
+
+static void inject(sim_time_t len, int mark) {
+  inj[inj_in].t = inj_at;
+  inj[inj_in].mark = mark;
+  inj_in = (inj_in + 1) % INJ;
+  inj_at += len;
+}
+
+static void inject_frame(unsigned code, sim_time_t b) {
+  int i;
+
+  inject(b, 0);
+  for (i = 0; i < nbits; i++)
+    inject(b, (code >> i) & 1);
+  inject(b + b / 2, 1);
+}
+
+// UTF-8 for the utf8 runs and what it should print as, before the bytes
+// not in Baudot are left out. A lead byte on its own is cut short by
+// whatever comes next.
+static const struct {
+  const char *in, *out;
+} utf8_samples[] = {
+    {"\xC3\xA9", "E"},     {"\xC3\x9F", "SS"},      {"\xC5\x81", "L"},
+    {"\xC2\xB0", "DEG"},   {"\xC2\xAD", ""},        {"\xE2\x80\x94", "-"},
+    {"\xE2\x80\x9C", "\""}, {"\xE2\x82\xAC", "EUR"}, {"\xE2\x80\xA6", "..."},
+    {"\xF0\x9F\x98\x80", ""}, {"\xC3", ""},          {"\xE2\x80", ""},
+};
+#define NSAMPLES (sizeof(utf8_samples) / sizeof(utf8_samples[0]))
+
+static int utf8_sample_at(size_t i) {
+  unsigned k;
+  size_t n;
+
+  for (k = 0; k < NSAMPLES; k++) {
+    n = strlen(utf8_samples[k].in);
+    if ((i + n <= input_len) && !memcmp(input + i, utf8_samples[k].in, n))
+      return k;
+  }
+  return -1;
+}
+
+// text for translate mode: mostly things with a Baudot code, some without,
+// line ends, shift chars and the odd control char (not DC2/DC4, they work
+// the relays)
+static void make_text(void) {
+  static const char extra[] = "@*%!\"_;<>[]^~|`\t";
+  size_t i, n;
+  unsigned long r;
+  unsigned k;
+
+  input_len = 50 + rnd_n(400);
+  for (i = 0; i < input_len; i++) {
+    r = rnd_n(100);
+    if ((flags & CONF_UTF8) && (r < 5)) {
+      k = rnd_n(NSAMPLES);
+      n = strlen(utf8_samples[k].in);
+      if (i + n <= input_len) {
+        memcpy(input + i, utf8_samples[k].in, n);
+        i += n - 1;
+        continue;
+      }
+    }
+    if (r < 40)
+      input[i] = 'a' + rnd_n(26);
+    else if (r < 50)
+      input[i] = 'A' + rnd_n(26);
+    else if (r < 62)
+      input[i] = ' ';
+    else if (r < 72)
+      input[i] = '0' + rnd_n(10);
+    else if (r < 82)
+      input[i] = "-'(),.:/?&$#=+"[rnd_n(14)];
+    else if (r < 88)
+      input[i] = (rnd_n(2)) ? '\n' : '\r';
+    else if (r < 91)
+      input[i] = (rnd_n(2)) ? '{' : '}';
+    else if (r < 97)
+      input[i] = extra[rnd_n(sizeof(extra) - 1)];
+    else if ((r < 98) && (i + 1 < input_len)) {
+      input[i++] = PROFILE_SO; // all profiles hold table 0
+      input[i] = '0' + rnd_n(PROFILES);
+    } else
+      do
+        input[i] = 1 + rnd_n(31);
+      while ((input[i] == 0x12) || (input[i] == 0x14));
+  }
+}
+
+// raw codes or 8 bit bytes, again without DC2/DC4, which work the relays
+// in every mode
+static void make_bytes(void) {
+  size_t i;
+
+  input_len = 50 + rnd_n(400);
+  for (i = 0; i < input_len; i++)
+    do
+      input[i] = (flags & CONF_8BIT) ? rnd_n(256) : rnd_n(32);
+    while ((input[i] == 0x12) || (input[i] == 0x14));
+}
+
+static int find(const char *table, char c) {
+  int i;
+  for (i = 1; i < 32; i++)
+    if (table[i] == c)
+      return i;
+  return -1;
+}
+
+static int has_baudot(char c) {
+  return c && ((find(ltrs, c) >= 0) || (find(figs, c) >= 0));
+}
+
+// the printable chars of a stream of Baudot frames, following its shifts
+static size_t decode(const uint8_t *codes, size_t n, int usos, char *out,
+                     int *shift) {
+  size_t i, len = 0;
+  char c;
+
+  for (i = 0; i < n; i++) {
+    if (codes[i] == LTRS || codes[i] == FIGS) {
+      *shift = codes[i];
+      continue;
+    }
+    if (usos && (codes[i] == 0x04))
+      *shift = LTRS;
+    c = (*shift == FIGS) ? figs[codes[i] & 0x1F] : ltrs[codes[i] & 0x1F];
+    if (isgraph((unsigned char)c))
+      out[len++] = c;
+  }
+  return len;
+}
+
+static void compare(const char *what, const char *got, size_t ngot,
+                    const char *want, size_t nwant) {
+  size_t i;
+
+  for (i = 0; (i < ngot) && (i < nwant); i++)
+    if (got[i] != want[i])
+      break;
+  if ((i == ngot) && (i == nwant))
+    return;
+  fail("%s differs at char %zu of %zu/%zu: got \"%.12s\", want \"%.12s\"",
+       what, i, ngot, nwant, got + i, want + i);
+}
+
+// checks on the host stream, before the noise
+static void check_stream(void) {
+  static char want[MAXLEN], got[4 * MAXLEN], back[8 * MAXLEN];
+  size_t nwant = 0, ngot, nback = 0, i;
+  int shift = LTRS;
+  const char *s;
+  uint8_t c;
+  int k;
+
+  if (wire_fe)
+    fail("%ld frames without a stop bit", wire_fe);
+  if (nwire && (min_stop < 1.0))
+    fail("stop bit only %.2f bits", min_stop);
+  if (stats_rx_overruns)
+    fail("%u overruns receiving the echo", stats_rx_overruns);
+
+  // Someone typed over us: our frames still have to be right on the wire,
+  // and each one came back as itself or was counted as a collision. What
+  // the host and the shift tracking make of the mess isn't checked.
+  if (collide_frame) {
+    if ((flags & CONF_DROPECHO) && (stats.echoes + stats_collisions != nwire))
+      fail("%zu frames sent, %lu came back, %u collisions", nwire,
+           (unsigned long)stats.echoes, stats_collisions);
+  } else {
+    if (stats_framing_errors)
+      fail("%u framing errors receiving the echo", stats_framing_errors);
+    if (stats_collisions)
+      fail("%u collisions with nobody else on the loop", stats_collisions);
+    if ((flags & CONF_DROPECHO) && (stats.echoes != nwire))
+      fail("%lu of %zu echoes dropped", (unsigned long)stats.echoes, nwire);
+  }
+
+  if (flags & CONF_TRANSLATE) {
+    for (i = 0; i < input_len; i++) {
+      if ((flags & CONF_UTF8) && (input[i] >= 0x80)) {
+        k = utf8_sample_at(i);
+        for (s = utf8_samples[k].out; *s; s++)
+          if (has_baudot(*s))
+            want[nwant++] = *s;
+        i += strlen(utf8_samples[k].in) - 1;
+        continue;
+      }
+      c = toupper(input[i]);
+      if ((input[i] == '{') || (input[i] == '}'))
+        continue;
+      if ((c == PROFILE_SO) && (i + 1 < input_len) && (input[i + 1] >= '0') &&
+          (input[i + 1] < '0' + PROFILES)) {
+        i++;
+        continue;
+      }
+      if (isgraph(c) && has_baudot(c))
+        want[nwant++] = c;
+    }
+    ngot = decode(wire, nwire, flags & CONF_UNSHIFT_ON_SPACE, got, &shift);
+    // a shift typed in between moves the machine, and so what we send
+    if (!collide_frame || ((collide_code != LTRS) && (collide_code != FIGS) &&
+                           (collide_code != 0x04)))
+      compare("wire", got, ngot, want, nwant);
+    if (collide_frame)
+      return;
+    // not knowing is fine, a wrong guess isn't
+    if ((baudot_shift_send != SHIFT_UNKNOWN) && (baudot_shift_send != shift))
+      fail("sending thinks it's in %s, the wire is in %s",
+           (baudot_shift_send == FIGS) ? "FIGS" : "LTRS",
+           (shift == FIGS) ? "FIGS" : "LTRS");
+    if (baudot_shift_rcv != shift)
+      fail("receiving thinks it's in %s, the wire is in %s",
+           (baudot_shift_rcv == FIGS) ? "FIGS" : "LTRS",
+           (shift == FIGS) ? "FIGS" : "LTRS");
+    for (i = 0; i < echo_mark; i++)
+      if (isgraph(echo[i]))
+        back[nback++] = echo[i];
+    compare("echo", back, nback, got, (flags & CONF_DROPECHO) ? 0 : ngot);
+    return;
+  }
+
+  // raw and 8 bit: the bytes themselves, the echo leaves out NULs
+  for (i = 0; i < input_len; i++)
+    want[nwant++] = (flags & CONF_8BIT) ? input[i] : (input[i] & 0x1F);
+  compare("wire", (char *)wire, nwire, want, nwant);
+  if (collide_frame)
+    return;
+  for (i = 0; i < nwire; i++)
+    if (wire[i])
+      got[nback++] = wire[i];
+  compare("echo", (char *)echo, echo_mark, got,
+          (flags & CONF_DROPECHO) ? 0 : nback);
+}
+
+// After the noise: frames at up to 2% off speed. In translate mode they
+// start with a shift, which is all the receiver needs to get back in step.
+static uint8_t tail[64];
+static size_t ntail;
+
+static void send_noise_and_tail(void) {
+  sim_time_t b = (sim_time_t)(bit * (1 + ((double)rnd_n(401) - 200) / 10000));
+  int i, n, mark = 0;
+
+  inj_at = sim_now + 10 * SIM_MS;
+  n = 5 + rnd_n(40);
+  for (i = 0; i < n; i++) {
+    switch (rnd_n(4)) {
+    case 0: // glitch
+      inject(rnd_n(bit / 3 + 1) + SIM_US, mark);
+      break;
+    case 1: // long break
+      inject(bit * (10 + rnd_n(40)), mark);
+      break;
+    default: // something like bits
+      inject(bit / 20 + rnd_n(3 * bit), mark);
+    }
+    mark = !mark;
+  }
+  inject(bit * 3 * (nbits + 3), 1);
+
+  ntail = 8 + rnd_n(40);
+  for (i = 0; i < (int)ntail; i++) {
+    if (flags & CONF_8BIT)
+      tail[i] = 1 + rnd_n(255);
+    else if ((i == 0) && (flags & CONF_TRANSLATE))
+      tail[i] = rnd_n(2) ? LTRS : FIGS;
+    else
+      tail[i] = 1 + rnd_n(31);
+    inject_frame(tail[i], b);
+  }
+  inject(bit, 1);
+}
+
+static void check_tail(void) {
+  static char want[128], got[8 * MAXLEN];
+  size_t nwant = 0, ngot = 0, i;
+  int shift = LTRS;
+
+  if (flags & CONF_TRANSLATE) {
+    nwant = decode(tail, ntail, flags & CONF_UNSHIFT_ON_SPACE, want, &shift);
+    for (i = echo_mark; i < necho; i++)
+      if (isgraph(echo[i]))
+        got[ngot++] = echo[i];
+  } else {
+    for (i = 0; i < ntail; i++)
+      want[nwant++] = tail[i];
+    for (i = echo_mark; i < necho; i++)
+      got[ngot++] = echo[i];
+  }
+  // the noise itself may have been read as chars, the tail has to come last
+  if (ngot > nwant)
+    compare("echo after noise", got + ngot - nwant, nwant, want, nwant);
+  else
+    compare("echo after noise", got, ngot, want, nwant);
+
+  // half duplex, that was someone at the keyboard, so the machine is in
+  // whatever shift they left it in
+  if ((flags & CONF_TRANSLATE) && (flags & CONF_HALFDUPLEX) &&
+      (baudot_shift_send != shift))
+    fail("sending didn't follow the keyboard to %s",
+         (shift == FIGS) ? "FIGS" : "LTRS");
+}
+
+static void flag_names(char *out) {
+  out[0] = 0;
+  if (flags & CONF_TRANSLATE)
+    strcat(out, "translate");
+  else
+    strcat(out, (flags & CONF_8BIT) ? "8bit" : "raw");
+  if (flags & CONF_CRLF)
+    strcat(out, " crlf");
+  if (flags & CONF_AUTOCR)
+    strcat(out, " autocr");
+  if (flags & CONF_WORDWRAP)
+    strcat(out, " wordwrap");
+  if (flags & CONF_UNSHIFT_ON_SPACE)
+    strcat(out, " usos");
+  if (flags & CONF_HALFDUPLEX)
+    strcat(out, collide_frame ? " hdx+kbd" : " hdx");
+  if (flags & CONF_DROPECHO)
+    strcat(out, " dropecho");
+  if (flags & CONF_UTF8)
+    strcat(out, " utf8");
+}
+
+
+static void finish(void) {
+  char name[64];
+  double secs = (t_sent - t_begin) / 1e9;
+  double frame = (nbits + 1 + min_stop) * bit / 1e9;
+
+  check_tail();
+  flag_names(name);
+  fprintf(sim_out,
+          "%-10lu %-28s %3u baud %5zu in %5zu frames %6.2f char/s, line "
+          "%3.0f%% busy, stop %.2f  %s\n",
+          run_seed, name, divisor_to_baud(divisor), input_len, nwire,
+          secs > 0 ? input_len / secs : 0,
+          secs > 0 ? 100.0 * wire_at_quiet * frame / secs : 0, min_stop,
+          failures ? "FAIL" : "ok");
+  fflush(sim_out);
+  _exit(failures ? 2 : 0);
+}
+
+void model_task(void) {
+  if (phase == PH_BOOT) {
+    if (boot_state != BOOT_DONE)
+      return;
+    confflags = flags;
+    esc_char = 0; // random bytes would trip it
+    linewidth = width;
+    crfill = fill_n;
+    crfill_cols = fill_cols;
+    fillchar = fill_kind;
+    set_softuart_divisor(divisor);
+    phase = PH_STREAM;
+    t_begin = sim_now;
+    t_quiet = sim_now;
+    sim_host_write(input, input_len);
+    if (collide_frame) {
+      inj_at = sim_now + collide_frame * (nbits + 2) * bit;
+      inject_frame(collide_code, bit);
+    }
+    return;
+  }
+  if (wd.busy || (rxq_out != rxq_in) || (inj_out != inj_in))
+    return;
+  // everything sent, the line idle for a couple of frames and any word
+  // held for wrapping let go (LINEOUT_WORD_IDLE)
+  if (sim_host_pending() || (sim_now - t_quiet < 4 * (nbits + 3) * bit +
+                                                     LINEOUT_WORD_IDLE * SIM_MS))
+    return;
+  if (phase == PH_STREAM) {
+    t_sent = wd.stop_from > t_begin ? wd.stop_from : sim_now;
+    wire_at_quiet = nwire;
+    echo_mark = necho;
+    check_stream();
+    send_noise_and_tail();
+    phase = PH_TAIL;
+    return;
+  }
+  finish();
+}
+
+static void run(unsigned long s) {
+  static const uint16_t extras[] = {CONF_CRLF, CONF_AUTOCR, CONF_WORDWRAP,
+                                    CONF_UNSHIFT_ON_SPACE, CONF_HALFDUPLEX,
+                                    CONF_DROPECHO, CONF_UTF8};
+  unsigned i;
+
+  run_seed = s;
+  rnd_state = s * 2654435761UL + 0x9E3779B9UL;
+  switch (rnd_n(5)) {
+  case 0:
+    flags = 0;
+    break;
+  case 1:
+    flags = CONF_8BIT;
+    break;
+  default:
+    flags = CONF_TRANSLATE;
+  }
+  for (i = 0; i < sizeof(extras) / sizeof(extras[0]); i++)
+    if (rnd_n(2))
+      flags |= extras[i];
+  if (flags & CONF_8BIT)
+    flags &= ~CONF_UNSHIFT_ON_SPACE;
+  if (!(flags & CONF_TRANSLATE))
+    flags &= ~CONF_UTF8;
+  divisor = speeds[rnd_n(NSPEEDS)][1];
+  bit = 3LL * (divisor + 1) * 4000; // Timer1 runs at 3x baud, 4us a count
+  nbits = (flags & CONF_8BIT) ? 8 : 5;
+  jitter = rnd_n(4) / 100.0;
+  width = 20 + rnd_n(60);
+  fill_n = rnd_n(3);
+  fill_cols = rnd_n(2) ? 0 : 10 + rnd_n(30);
+  fill_kind = rnd_n(3);
+  if (flags & CONF_TRANSLATE)
+    make_text();
+  else
+    make_bytes();
+  if ((flags & CONF_HALFDUPLEX) && !rnd_n(3)) {
+    collide_frame = 1 + rnd_n(input_len);
+    collide_code = 1 + rnd_n((1 << nbits) - 1);
+  }
+  if (verbose) {
+    printf("seed %lu: width %u fill %u,%u,%u jitter %.0f%% kbd %zu,%u\n", s,
+            width, fill_n, fill_cols, fill_kind, jitter * 100, collide_frame, collide_code);
+    printf("  input:");
+    for (i = 0; i < input_len; i++)
+      printf(isprint(input[i]) ? "%c" : "\\x%02x", input[i]);
+    printf("\n");
+    fflush(stdout);
+  }
+  firmware_main();
+}
+
+int main(int argc, char **argv) {
+  int opt, i, n = 50, failed = 0, status;
+  unsigned long seed = 1, one = 0;
+  pid_t pid;
+
+  while ((opt = getopt(argc, argv, "n:s:r:v")) != -1) {
+    switch (opt) {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      one = strtoul(optarg, NULL, 0);
+      n = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n runs] [-s first_seed] [-r seed] [-v]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  // each run in its own process, so the firmware starts from reset
+  for (i = 0; i < n; i++) {
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      run(one ? one : seed + i);
+      _exit(1);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+      failed++;
+  }
+  printf("%d runs, %d failed\n", n, failed);
+  return failed ? 1 : 0;
+}
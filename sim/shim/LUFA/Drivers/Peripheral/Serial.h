@@ -0,0 +1,2 @@
+#define SERIAL_UBBRVAL(baud) ((F_CPU / 16 / (baud)) - 1)
+#define SERIAL_2X_UBBRVAL(baud) ((F_CPU / 8 / (baud)) - 1)
@@ -0,0 +1,93 @@
+/* Host stand-in for the parts of LUFA the firmware uses. The CDC interface
+ * talks to the simulated host in sim.c instead of an endpoint. */
+
+#ifndef _SIM_LUFA_USB_H_
+#define _SIM_LUFA_USB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ATTR_PACKED __attribute__((packed))
+#define ATTR_WARN_UNUSED_RESULT
+#define ATTR_NON_NULL_PTR_ARG(...)
+
+#define ENDPOINT_DIR_IN 0x80
+#define ENDPOINT_DIR_OUT 0x00
+#define ENDPOINT_RWSTREAM_NoError 0
+#define ENDPOINT_READYWAIT_NoError 0
+
+enum {
+  DEVICE_STATE_Unattached,
+  DEVICE_STATE_Powered,
+  DEVICE_STATE_Default,
+  DEVICE_STATE_Addressed,
+  DEVICE_STATE_Configured,
+  DEVICE_STATE_Suspended
+};
+extern volatile uint8_t USB_DeviceState;
+
+#define CDC_CONTROL_LINE_OUT_DTR (1 << 0)
+#define CDC_CONTROL_LINE_OUT_RTS (1 << 1)
+#define CDC_PARITY_None 0
+#define CDC_PARITY_Odd 1
+#define CDC_PARITY_Even 2
+#define CDC_LINEENCODING_OneStopBit 0
+#define CDC_LINEENCODING_TwoStopBits 2
+
+#define GlobalInterruptEnable() ((void)0)
+#define GlobalInterruptDisable() ((void)0)
+
+typedef struct {
+  uint8_t Address;
+  uint16_t Size;
+  uint8_t Type;
+  uint8_t Banks;
+} USB_Endpoint_Table_t;
+
+typedef struct {
+  struct {
+    uint8_t ControlInterfaceNumber;
+    USB_Endpoint_Table_t DataINEndpoint;
+    USB_Endpoint_Table_t DataOUTEndpoint;
+    USB_Endpoint_Table_t NotificationEndpoint;
+  } Config;
+  struct {
+    struct {
+      uint16_t HostToDevice;
+      uint16_t DeviceToHost;
+    } ControlLineStates;
+    struct {
+      uint32_t BaudRateBPS;
+      uint8_t CharFormat;
+      uint8_t ParityType;
+      uint8_t DataBits;
+    } LineEncoding;
+  } State;
+} USB_ClassInfo_CDC_Device_t;
+
+// only so Descriptors.h parses
+typedef struct { uint8_t x; } USB_Descriptor_Configuration_Header_t;
+typedef struct { uint8_t x; } USB_Descriptor_Interface_t;
+typedef struct { uint8_t x; } USB_Descriptor_Endpoint_t;
+typedef struct { uint8_t x; } USB_CDC_Descriptor_FunctionalHeader_t;
+typedef struct { uint8_t x; } USB_CDC_Descriptor_FunctionalACM_t;
+typedef struct { uint8_t x; } USB_CDC_Descriptor_FunctionalUnion_t;
+
+void USB_Init(void);
+void USB_USBTask(void);
+bool CDC_Device_ConfigureEndpoints(USB_ClassInfo_CDC_Device_t *cdc);
+void CDC_Device_ProcessControlRequest(USB_ClassInfo_CDC_Device_t *cdc);
+void CDC_Device_USBTask(USB_ClassInfo_CDC_Device_t *cdc);
+uint8_t CDC_Device_SendByte(USB_ClassInfo_CDC_Device_t *cdc, uint8_t c);
+uint8_t CDC_Device_SendData(USB_ClassInfo_CDC_Device_t *cdc, const void *buf,
+                            uint16_t len);
+uint8_t CDC_Device_SendString(USB_ClassInfo_CDC_Device_t *cdc, const char *s);
+uint8_t CDC_Device_Flush(USB_ClassInfo_CDC_Device_t *cdc);
+int16_t CDC_Device_ReceiveByte(USB_ClassInfo_CDC_Device_t *cdc);
+uint16_t CDC_Device_BytesReceived(USB_ClassInfo_CDC_Device_t *cdc);
+
+#define CDC_Device_SendString_P CDC_Device_SendString
+#define CDC_Device_SendData_P CDC_Device_SendData
+
+#endif
@@ -0,0 +1,24 @@
+/* Host stand-in for <avr/eeprom.h>, backed by an array in sim.c that
+ * starts out blank (0xFF) like a new chip. */
+
+#ifndef _SIM_AVR_EEPROM_H_
+#define _SIM_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait() ((void)0)
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+void eeprom_read_block(void *dst, const void *addr, size_t n);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_word(uint16_t *addr, uint16_t value);
+void eeprom_update_word(uint16_t *addr, uint16_t value);
+void eeprom_write_block(const void *src, void *addr, size_t n);
+void eeprom_update_block(const void *src, void *addr, size_t n);
+
+#endif
@@ -0,0 +1,29 @@
+/* Host stand-in for <avr/interrupt.h>. An ISR is an ordinary function that
+ * sim.c calls when its event comes due, never while the firmware is in the
+ * middle of something, so sei() and cli() have nothing to do. */
+
+#ifndef _SIM_AVR_INTERRUPT_H_
+#define _SIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+
+#define TIMER0_COMPA_vect sim_timer0_compa
+#define TIMER1_COMPA_vect sim_timer1_compa
+#define TIMER1_COMPB_vect sim_timer1_compb
+#define TIMER1_OVF_vect sim_timer1_ovf
+#define TIMER1_CAPT_vect sim_timer1_capt
+#define TIMER3_COMPA_vect sim_timer3_compa
+#define TIMER3_OVF_vect sim_timer3_ovf
+#define PCINT0_vect sim_pcint0
+#define USART1_RX_vect sim_usart1_rx
+#define USART1_UDRE_vect sim_usart1_udre
+#define USART1_TX_vect sim_usart1_tx
+
+#define sei() ((void)0)
+#define cli() ((void)0)
+
+#endif
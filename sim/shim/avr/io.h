@@ -0,0 +1,55 @@
+/* Host stand-in for <avr/io.h>: every register the firmware touches is a
+ * plain variable, defined in sim.c. The simulator reads and writes them
+ * around the ISRs, see sim.c. */
+
+#ifndef _SIM_AVR_IO_H_
+#define _SIM_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(b) (1 << (b))
+
+#define SIM_REGS8(R)                                                           \
+  R(PINB) R(PINC) R(PIND) R(PINE) R(PINF) R(PORTB) R(PORTC) R(PORTD)           \
+  R(PORTE) R(PORTF) R(DDRB) R(DDRC) R(DDRD) R(DDRE) R(DDRF) R(TCCR0A)          \
+  R(TCCR0B) R(OCR0A) R(OCR0B) R(TIMSK0) R(TCNT0) R(TIFR0) R(TCCR1A) R(TCCR1B)  \
+  R(TCCR1C) R(TIMSK1) R(TIFR1) R(TCCR3A) R(TCCR3B) R(TIMSK3) R(TIFR3) R(PCICR) \
+  R(PCMSK0) R(PCIFR) R(MCUSR) R(SREG) R(SMCR) R(GPIOR0) R(UCSR1A) R(UCSR1B)    \
+  R(UCSR1C) R(UDR1) R(EIMSK) R(EICRA) R(EIFR)
+#define SIM_REGS16(R)                                                          \
+  R(OCR1A) R(OCR1B) R(ICR1) R(TCNT1) R(OCR3A) R(TCNT3) R(UBRR1)
+
+#define SIM_DECLARE8(r) extern volatile uint8_t r;
+#define SIM_DECLARE16(r) extern volatile uint16_t r;
+SIM_REGS8(SIM_DECLARE8)
+SIM_REGS16(SIM_DECLARE16)
+
+enum { PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7 };
+enum { PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7 };
+enum { PE6 = 6 };
+enum { PF4 = 4 };
+
+enum { WGM01 = 1, CS00 = 0, CS01 = 1, CS02 = 2, OCIE0A = 1, OCF0A = 1 };
+enum { WGM10 = 0, WGM11 = 1, WGM12 = 3, WGM13 = 4 };
+enum { CS10 = 0, CS11 = 1, CS12 = 2 };
+enum { TOIE1 = 0, OCIE1A = 1, OCIE1B = 2, ICIE1 = 5 };
+enum { TOV1 = 0, OCF1A = 1, OCF1B = 2, ICF1 = 5 };
+enum { ICES1 = 6, ICNC1 = 7 };
+enum { CS30 = 0, CS31 = 1, CS32 = 2, TOIE3 = 0, OCIE3A = 1, TOV3 = 0, OCF3A = 1 };
+enum { PCIE0 = 0, PCIF0 = 0, PCINT6 = 6 };
+enum { WDRF = 3 };
+enum { INT2 = 2, INT3 = 3 };
+enum { MPCM1 = 0, U2X1 = 1, UPE1 = 2, DOR1 = 3, FE1 = 4, UDRE1 = 5, TXC1 = 6,
+       RXC1 = 7 };
+enum { TXB81 = 0, RXB81 = 1, UCSZ12 = 2, TXEN1 = 3, RXEN1 = 4, UDRIE1 = 5,
+       TXCIE1 = 6, RXCIE1 = 7 };
+enum { UCPOL1 = 0, UCSZ10 = 1, UCSZ11 = 2, USBS1 = 3, UPM10 = 4, UPM11 = 5 };
+
+// the simulator's clock, for busy waits; see sim.c
+void sim_poll(void);
+void sim_sleep(void);
+
+#define E2END 0x3FF
+#define RAMEND 0xAFF
+
+#endif
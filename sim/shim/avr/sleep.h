@@ -0,0 +1,17 @@
+/* Host stand-in for <avr/sleep.h>: sleeping skips ahead to the next
+ * interrupt. */
+
+#ifndef _SIM_AVR_SLEEP_H_
+#define _SIM_AVR_SLEEP_H_
+
+void sim_sleep(void);
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable() ((void)0)
+#define sleep_disable() ((void)0)
+#define sleep_cpu() sim_sleep()
+#define sleep_mode() sim_sleep()
+
+#endif
@@ -0,0 +1,3 @@
+#define wdt_reset() ((void)0)
+#define wdt_disable() ((void)0)
+#define wdt_enable(t) ((void)(t))
@@ -0,0 +1,15 @@
+/* Host stand-in for <util/atomic.h>. Nothing can interrupt the block, but
+ * code that polls millis() in a loop has to see the clock move, so each
+ * block costs a microsecond of simulated time. */
+
+#ifndef _SIM_UTIL_ATOMIC_H_
+#define _SIM_UTIL_ATOMIC_H_
+
+void sim_poll(void);
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+#define ATOMIC_BLOCK(type)                                                     \
+  for (int sim_atomic_ = (sim_poll(), 1); sim_atomic_; sim_atomic_ = 0)
+
+#endif
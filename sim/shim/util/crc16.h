@@ -0,0 +1,33 @@
+/* Host versions of the avr-libc crc helpers, same results. */
+
+#ifndef _SIM_UTIL_CRC16_H_
+#define _SIM_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+  int i;
+
+  crc ^= a;
+  for (i = 0; i < 8; ++i)
+    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  return crc;
+}
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+  data ^= crc & 0xFF;
+  data ^= data << 4;
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^
+          ((uint16_t)data << 3));
+}
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data) {
+  int i;
+
+  crc ^= (uint16_t)data << 8;
+  for (i = 0; i < 8; i++)
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  return crc;
+}
+
+#endif
@@ -0,0 +1,11 @@
+/* Host stand-in for <util/delay.h>: busy waits pass simulated time. */
+
+#ifndef _SIM_UTIL_DELAY_H_
+#define _SIM_UTIL_DELAY_H_
+
+void sim_delay_us(double us);
+
+#define _delay_ms(ms) sim_delay_us((ms) * 1000.0)
+#define _delay_us(us) sim_delay_us(us)
+
+#endif
@@ -0,0 +1,321 @@
+/* Runs the real firmware sources on the host, against the headers in shim/.
+ *
+ * Time is simulated, in nanoseconds. The firmware runs as written until it
+ * gives the clock a chance to move: sleeping, a busy wait, an ATOMIC_BLOCK
+ * (a microsecond each, so millis() loops get somewhere) or a pass of the
+ * main loop (USB_USBTask(), SIM_LOOP_NS). Then every event that falls due
+ * runs in order: the 1ms tick, the Timer1 compare that clocks the
+ * transmitter, the Timer3 compare and overflow of the edge receiver, and
+ * the driver's own events, which can move the RX pin and so raise PCINT0.
+ * An ISR never interrupts the firmware halfway through something, so the
+ * races a real AVR has aren't here; this is for timing and throughput, not
+ * for proving the locking.
+ */
+
+#include "sim.h"
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <LUFA/Drivers/USB/USB.h>
+
+#define SIM_COUNT_NS 4000 // one count of a clk/64 timer at 16MHz
+#define SIM_LOOP_NS (20 * SIM_US) // rough cost of a main loop pass
+#define SIM_POLL_NS SIM_US
+
+#define SIM_DEFINE8(r) volatile uint8_t r;
+#define SIM_DEFINE16(r) volatile uint16_t r;
+SIM_REGS8(SIM_DEFINE8)
+SIM_REGS16(SIM_DEFINE16)
+
+volatile uint8_t USB_DeviceState;
+
+// not every ISR is built in every configuration
+#define SIM_VECTOR(v) void v(void) __attribute__((weak));
+SIM_VECTOR(TIMER0_COMPA_vect)
+SIM_VECTOR(TIMER1_COMPA_vect)
+SIM_VECTOR(TIMER3_COMPA_vect)
+SIM_VECTOR(TIMER3_OVF_vect)
+SIM_VECTOR(PCINT0_vect)
+
+void EVENT_USB_Device_ConfigurationChanged(void);
+
+sim_time_t sim_now = 0;
+FILE *sim_out;
+
+static sim_time_t t0_next = SIM_MS;
+static sim_time_t t1_next = 0;
+static uint8_t t1_pending = 0; // compare while its interrupt was off
+static sim_time_t t3_compa_done = -1, t3_ovf_done = -1;
+static uint8_t in_isr = 0;
+static int tx_last = -1;
+
+static uint8_t eeprom[E2END + 1];
+
+static uint8_t *host_buf;
+static size_t host_len, host_pos, host_size;
+static uint8_t usb_up = 0;
+
+static void tx_check(void) {
+  int mark = !(PORTD & _BV(PD7)); // inverted, see set_tx_pin_high()
+
+  if (mark != tx_last) {
+    tx_last = mark;
+    model_tx(mark);
+  }
+}
+
+static void fire(void (*isr)(void)) {
+  if (isr == NULL)
+    return;
+  TCNT3 = (sim_now / SIM_COUNT_NS) & 0xFFFF;
+  in_isr = 1;
+  isr();
+  in_isr = 0;
+  TIFR3 = 0; // flags are write-one-to-clear, nothing reads them back here
+  tx_check();
+}
+
+static sim_time_t t1_period(void) {
+  return ((sim_time_t)OCR1A + 1) * SIM_COUNT_NS;
+}
+
+// the first time from now on that Timer3 reads match, skipping the one
+// that has just been handled
+static sim_time_t t3_next(uint16_t match, sim_time_t done) {
+  int64_t count = (sim_now + SIM_COUNT_NS - 1) / SIM_COUNT_NS;
+  sim_time_t t;
+
+  count += (match - count) & 0xFFFF;
+  t = count * SIM_COUNT_NS;
+  if (t == done)
+    t += 0x10000LL * SIM_COUNT_NS;
+  return t;
+}
+
+static sim_time_t t3_compa_next(void) {
+  if (!(TIMSK3 & _BV(OCIE3A)) || !(TCCR3B & 7))
+    return SIM_NEVER;
+  return t3_next(OCR3A, t3_compa_done);
+}
+
+static sim_time_t t3_ovf_next(void) {
+  if (!(TIMSK3 & _BV(TOIE3)) || !(TCCR3B & 7))
+    return SIM_NEVER;
+  return t3_next(0, t3_ovf_done);
+}
+
+// an interrupt enabled with its flag already up runs straight away
+static void pending(void) {
+  if (t1_pending && (TIMSK1 & _BV(OCIE1A))) {
+    t1_pending = 0;
+    fire(TIMER1_COMPA_vect);
+  }
+}
+
+static sim_time_t next_event(void) {
+  sim_time_t t = t0_next, x;
+
+  if (TCNT1 == 0) { // set_softuart_divisor() restarted Timer1
+    TCNT1 = 1;
+    t1_next = sim_now + t1_period();
+  }
+  if ((TCCR1B & 7) && (t1_next < t))
+    t = t1_next;
+  if ((x = t3_compa_next()) < t)
+    t = x;
+  if ((x = t3_ovf_next()) < t)
+    t = x;
+  if ((x = model_next()) < t)
+    t = x;
+  return t;
+}
+
+// run everything due up to and including until, then leave the clock there
+static void advance(sim_time_t until) {
+  sim_time_t t;
+
+  if (in_isr)
+    return;
+  tx_check();
+  for (;;) {
+    pending();
+    t = next_event();
+    if (t > until)
+      break;
+    if (t > sim_now)
+      sim_now = t;
+    if (t == t0_next) {
+      t0_next += SIM_MS;
+      if (TIMSK0 & _BV(OCIE0A))
+        fire(TIMER0_COMPA_vect);
+    }
+    if ((TCCR1B & 7) && (t == t1_next)) {
+      t1_next += t1_period();
+      if (TIMSK1 & _BV(OCIE1A))
+        fire(TIMER1_COMPA_vect);
+      else
+        t1_pending = 1;
+    }
+    if (t == t3_compa_next()) {
+      t3_compa_done = t;
+      fire(TIMER3_COMPA_vect);
+    }
+    if (t == t3_ovf_next()) {
+      t3_ovf_done = t;
+      fire(TIMER3_OVF_vect);
+    }
+    if (t == model_next()) {
+      model_event();
+      tx_check();
+    }
+  }
+  if (until > sim_now)
+    sim_now = until;
+}
+
+void sim_poll(void) { advance(sim_now + SIM_POLL_NS); }
+
+void sim_sleep(void) {
+  if (in_isr)
+    return;
+  tx_check();
+  pending();
+  advance(next_event());
+}
+
+void sim_delay_us(double us) { advance(sim_now + (sim_time_t)(us * SIM_US)); }
+
+void sim_rx(int mark) {
+  uint8_t pin = mark ? 0 : _BV(PB6); // through the inverting opto
+
+  if ((PINB & _BV(PB6)) == pin)
+    return;
+  PINB = (PINB & ~_BV(PB6)) | pin;
+  if ((PCICR & _BV(PCIE0)) && (PCMSK0 & _BV(PB6)))
+    fire(PCINT0_vect);
+}
+
+void sim_host_write(const void *buf, size_t len) {
+  if (host_len + len > host_size) {
+    host_size = (host_len + len) * 2;
+    host_buf = realloc(host_buf, host_size);
+  }
+  memcpy(host_buf + host_len, buf, len);
+  host_len += len;
+}
+
+size_t sim_host_pending(void) { return host_len - host_pos; }
+
+// eeprom
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+  return eeprom[(uintptr_t)addr & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+  uintptr_t a = (uintptr_t)addr;
+  return eeprom[a & E2END] | (eeprom[(a + 1) & E2END] << 8);
+}
+
+void eeprom_read_block(void *dst, const void *addr, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++)
+    ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)addr + i);
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+  eeprom[(uintptr_t)addr & E2END] = value;
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+  eeprom_write_byte(addr, value);
+}
+
+void eeprom_write_word(uint16_t *addr, uint16_t value) {
+  eeprom_write_byte((uint8_t *)addr, value & 0xFF);
+  eeprom_write_byte((uint8_t *)addr + 1, value >> 8);
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value) {
+  eeprom_write_word(addr, value);
+}
+
+void eeprom_write_block(const void *src, void *addr, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++)
+    eeprom_write_byte((uint8_t *)addr + i, ((const uint8_t *)src)[i]);
+}
+
+void eeprom_update_block(const void *src, void *addr, size_t n) {
+  eeprom_write_block(src, addr, n);
+}
+
+// USB: a host that configures the port, raises DTR and never stalls
+
+void USB_Init(void) {
+  sim_out = stdout;
+  memset(eeprom, 0xFF, sizeof(eeprom)); // a new chip
+  if (model_reset)
+    model_reset(); // or the one the driver wants to power up
+  PINB = 0;                             // loop idle, mark
+  PIND = PINE = PINF = 0xFF;            // switches and the button open
+  USB_DeviceState = DEVICE_STATE_Configured;
+}
+
+void USB_USBTask(void) {
+  if (in_isr)
+    return;
+  advance(sim_now + SIM_LOOP_NS);
+  model_task();
+}
+
+void CDC_Device_USBTask(USB_ClassInfo_CDC_Device_t *cdc) {
+  if (!usb_up) {
+    usb_up = 1;
+    cdc->State.ControlLineStates.HostToDevice |= CDC_CONTROL_LINE_OUT_DTR;
+    EVENT_USB_Device_ConfigurationChanged();
+  }
+}
+
+bool CDC_Device_ConfigureEndpoints(USB_ClassInfo_CDC_Device_t *cdc) {
+  return true;
+}
+
+void CDC_Device_ProcessControlRequest(USB_ClassInfo_CDC_Device_t *cdc) {}
+
+uint8_t CDC_Device_SendByte(USB_ClassInfo_CDC_Device_t *cdc, uint8_t c) {
+  model_usb_in(c);
+  return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t CDC_Device_SendData(USB_ClassInfo_CDC_Device_t *cdc, const void *buf,
+                            uint16_t len) {
+  uint16_t i;
+  for (i = 0; i < len; i++)
+    model_usb_in(((const uint8_t *)buf)[i]);
+  return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t CDC_Device_SendString(USB_ClassInfo_CDC_Device_t *cdc, const char *s) {
+  return CDC_Device_SendData(cdc, s, strlen(s));
+}
+
+uint8_t CDC_Device_Flush(USB_ClassInfo_CDC_Device_t *cdc) {
+  return ENDPOINT_READYWAIT_NoError;
+}
+
+// the host keeps the 16 byte OUT endpoint full
+uint16_t CDC_Device_BytesReceived(USB_ClassInfo_CDC_Device_t *cdc) {
+  size_t n = host_len - host_pos;
+  return (n > 16) ? 16 : n;
+}
+
+int16_t CDC_Device_ReceiveByte(USB_ClassInfo_CDC_Device_t *cdc) {
+  if (host_pos >= host_len)
+    return -1;
+  model_usb_take(host_pos);
+  return host_buf[host_pos++];
+}
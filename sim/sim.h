@@ -0,0 +1,38 @@
+/* Host side simulator for the firmware, see sim.c. A driver (ttysim.c)
+ * supplies the model_ functions: whatever hangs on the loop, and the host
+ * on the other end of the USB port. */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef int64_t sim_time_t; // nanoseconds since reset
+#define SIM_US 1000LL
+#define SIM_MS 1000000LL
+#define SIM_NEVER INT64_MAX
+
+extern sim_time_t sim_now;
+extern FILE *sim_out; // where the simulator reports, the firmware only has USB
+
+// the adapter's RX pin, 1 = mark. Takes effect (and interrupts) right away.
+void sim_rx(int mark);
+// queue bytes from the host; the firmware reads them as it gets to them
+void sim_host_write(const void *buf, size_t len);
+size_t sim_host_pending(void);
+
+// from the driver
+void model_tx(int mark);       // the adapter's TX pin changed, now
+sim_time_t model_next(void);   // when the model next needs model_event()
+void model_event(void);        // do whatever is due at sim_now
+void model_usb_in(uint8_t c);  // a byte from the adapter to the host
+void model_usb_take(size_t i); // the adapter took host byte i
+void model_task(void);         // once per pass of the firmware's main loop
+// optional: set up the eeprom as the unit had it, before the firmware starts
+void model_reset(void) __attribute__((weak));
+
+int firmware_main(void); // main() in main.c
+
+#endif
@@ -0,0 +1,687 @@
+/* Loopback teleprinter simulator: runs the firmware (see sim.c) with a
+ * mechanical teleprinter on the loop and a host that streams text at it,
+ * then reports what came out.
+ *
+ * The loop is a series loop, so the adapter hears everything it sends: the
+ * echo comes back through the RX opto with a little delay and jitter. The
+ * machine has its own idea of the baud rate (-e), a selector that needs a
+ * minimum stop time before it can start the next char (-S), a carriage
+ * return that takes time in proportion to how far the carriage has to go
+ * (-c), a right margin (-w) and optionally unshift on space. Anything
+ * printed while the carriage is still travelling is smeared somewhere along
+ * the line, anything past the margin piles up in the last column.
+ *
+ *   make -C sim && sim/ttysim            (every config at 45.45 baud)
+ *   sim/ttysim -b 75 -m translate,crlf,autocr -F 1,20,ltrs -p
+ *
+ * For each run it compares the printed page and the echo the host got back
+ * with what the host sent (printing chars only, so spaces turned into line
+ * breaks don't count): lost and garbled chars, chars smeared by the carriage
+ * or piled up at the margin, framing errors at the machine, the time from
+ * the adapter taking a char to the machine printing it and to the host
+ * seeing the echo, and printed chars per second of the whole run.
+ */
+
+#include "sim.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../conf.h"
+#include "../lineout.h"
+#include "../main.h"
+#include "../softuart.h"
+#include "../stats.h"
+
+#define BOOT_DONE 2 // from main.c
+extern uint8_t boot_state;
+extern uint16_t confflags;
+
+#define LTRS 0x1F
+#define FIGS 0x1B
+
+static const char ltrs[32] = {0,    'E', 0x0A, 'A', ' ', 'S', 'I', 'U',
+                              0x0D, 'D', 'R',  'J', 'N', 'F', 'C', 'K',
+                              'T',  'Z', 'L',  'W', 'H', 'Y', 'P', 'Q',
+                              'O',  'B', 'G',  0,   'M', 'X', 'V', 0};
+
+static const char figs[32] = {0,    '3', 0x0A, '-', ' ', '\'', '8', '7',
+                              0x0D, 0x05, '4', 0x07, ',', '$', ':',  '(',
+                              '5',  '+', ')',  '2', '#', '6',  '0', '1',
+                              '9',  '?', '&',  0,   '.', '/', '=',  0};
+
+// settings, from the command line
+static double baud = 45.45;
+static int nchars = 2000;
+static const char *textfile = NULL;
+static double speed_err = 0;      // machine speed error, percent
+static double stop_min = -1;      // bits, -1 = 1.42 for Baudot, 1 for ASCII
+static const char *stop_arg = "1.42/1";
+static int width = 72;            // machine's margin
+static double cr_base = 60;       // ms for any carriage return
+static double cr_col = 3;         // and this much per column travelled
+static double line_lat = 50;      // us through the opto
+static double line_jitter = 100;  // us either way
+static int adapter_width = 68;
+static int fill_n = 0, fill_cols = 0, fill_kind = FILL_LTRS;
+static unsigned long seed = 1;
+static int show_page = 0;
+
+static unsigned long rnd_state;
+
+static unsigned long rnd(void) {
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+// what the host sends, and the printing chars in it that should come out
+static uint8_t *input;
+static size_t input_len;
+static sim_time_t *taken; // when the adapter took input byte i
+
+struct expect {
+  char c;
+  size_t idx; // input byte it came from
+};
+static struct expect *expected;
+static size_t nexpected;
+
+// printing chars as they came out, at the machine and back at the host
+struct seen {
+  char c;
+  sim_time_t t;
+};
+static struct seen *printed, *echoed;
+static size_t nprinted, nechoed;
+
+static char *page;
+static size_t page_len;
+
+static void add_seen(struct seen *s, size_t *n, char c) {
+  s[*n].c = c;
+  s[*n].t = sim_now;
+  (*n)++;
+}
+
+// the machine
+static struct {
+  sim_time_t bit;
+  int nbits;
+  sim_time_t stop;
+  int usos;
+  int line; // loop level, 1 = mark
+  int busy; // in a char
+  sim_time_t start, next;
+  int k;
+  unsigned code;
+  int waiting; // for the selector to latch after a stop
+  sim_time_t ready;
+  int shift;
+  int column;
+  sim_time_t cr_until;
+  long frames, fe, smeared, margin;
+} tp;
+
+// echo edges on their way back through the opto
+#define RXQ 64
+static struct {
+  sim_time_t t;
+  int mark;
+} rxq[RXQ];
+static int rxq_in, rxq_out;
+static sim_time_t rxq_last;
+
+// run state
+static uint16_t run_flags;
+static int configured = 0;
+static sim_time_t t_begin, t_last_edge, t_limit;
+static int echo_shift = LTRS;
+
+static int mode_8bit(void) { return run_flags & CONF_8BIT; }
+static int mode_translate(void) { return run_flags & CONF_TRANSLATE; }
+
+static int encode(char c, int *shift) {
+  int i;
+
+  for (i = 0; i < 32; i++)
+    if (ltrs[i] == c) {
+      *shift = LTRS;
+      return i;
+    }
+  for (i = 0; i < 32; i++)
+    if (figs[i] == c) {
+      *shift = FIGS;
+      return i;
+    }
+  return -1;
+}
+
+static void page_add(char c) {
+  page[page_len++] = c;
+}
+
+static void tp_char(char c) {
+  if (c == '\r') {
+    sim_time_t t = sim_now + (sim_time_t)((cr_base + cr_col * tp.column) *
+                                          SIM_MS);
+    if (t > tp.cr_until)
+      tp.cr_until = t;
+    tp.column = 0;
+    return;
+  }
+  if (c == '\n') {
+    page_add('\n');
+    return;
+  }
+  if ((c != ' ') && !isgraph((unsigned char)c))
+    return;
+  if (sim_now < tp.cr_until) {
+    if (c != ' ')
+      tp.smeared++;
+    return;
+  }
+  if (tp.column >= width) {
+    if (c != ' ')
+      tp.margin++;
+    return;
+  }
+  tp.column++;
+  page_add(c);
+  if (c != ' ')
+    add_seen(printed, &nprinted, c);
+}
+
+static void tp_print(unsigned code) {
+  char c;
+
+  if (tp.nbits == 8) {
+    tp_char(toupper(code & 0x7F));
+    return;
+  }
+  if (code == LTRS || code == FIGS) {
+    tp.shift = code;
+    return;
+  }
+  c = (tp.shift == FIGS) ? figs[code] : ltrs[code];
+  if ((code == 0x04) && tp.usos)
+    tp.shift = LTRS;
+  tp_char(c);
+}
+
+static void tp_start(void) {
+  tp.busy = 1;
+  tp.start = sim_now;
+  tp.k = 1;
+  tp.code = 0;
+  tp.next = tp.start + tp.bit + tp.bit / 2;
+}
+
+static void tp_sample(void) {
+  if (tp.k <= tp.nbits) {
+    if (tp.line)
+      tp.code |= 1 << (tp.k - 1);
+    tp.k++;
+    // the stop is checked a quarter bit in, where the selector latches
+    if (tp.k <= tp.nbits)
+      tp.next = tp.start + tp.k * tp.bit + tp.bit / 2;
+    else
+      tp.next = tp.start + (tp.nbits + 1) * tp.bit + tp.bit / 4;
+    return;
+  }
+  if (!tp.line)
+    tp.fe++;
+  tp.frames++;
+  tp.busy = 0;
+  tp_print(tp.code);
+  tp.ready = tp.start + (tp.nbits + 1) * tp.bit + tp.stop;
+  tp.waiting = 1;
+}
+
+void model_tx(int mark) {
+  sim_time_t t;
+
+  tp.line = mark;
+  t_last_edge = sim_now;
+  if (!tp.busy && !tp.waiting && !mark)
+    tp_start();
+
+  t = sim_now + (sim_time_t)(line_lat * SIM_US);
+  if (line_jitter > 0)
+    t += (sim_time_t)(((long)(rnd() % 2001) - 1000) * line_jitter);
+  if (t <= rxq_last)
+    t = rxq_last + 1;
+  if (t <= sim_now)
+    t = sim_now + 1;
+  rxq_last = t;
+  rxq[rxq_in].t = t;
+  rxq[rxq_in].mark = mark;
+  rxq_in = (rxq_in + 1) % RXQ;
+}
+
+sim_time_t model_next(void) {
+  sim_time_t t = SIM_NEVER;
+
+  if (rxq_out != rxq_in)
+    t = rxq[rxq_out].t;
+  if (tp.busy && (tp.next < t))
+    t = tp.next;
+  if (tp.waiting && (tp.ready < t))
+    t = tp.ready;
+  return t;
+}
+
+void model_event(void) {
+  while ((rxq_out != rxq_in) && (rxq[rxq_out].t <= sim_now)) {
+    sim_rx(rxq[rxq_out].mark);
+    rxq_out = (rxq_out + 1) % RXQ;
+  }
+  if (tp.busy && (tp.next <= sim_now))
+    tp_sample();
+  if (tp.waiting && (tp.ready <= sim_now)) {
+    tp.waiting = 0;
+    if (!tp.line) // already in the next start bit
+      tp_start();
+  }
+}
+
+void model_usb_take(size_t i) { taken[i] = sim_now; }
+
+void model_usb_in(uint8_t c) {
+  if (!configured)
+    return;
+  if (!mode_translate() && !mode_8bit()) {
+    if (c == LTRS || c == FIGS) {
+      echo_shift = c;
+      return;
+    }
+    c &= 0x1F;
+    if ((c == 0x04) && (run_flags & CONF_UNSHIFT_ON_SPACE))
+      echo_shift = LTRS;
+    c = (echo_shift == FIGS) ? figs[c] : ltrs[c];
+  }
+  c = toupper(c & 0x7F);
+  if (isgraph(c))
+    add_seen(echoed, &nechoed, c);
+}
+
+// Line up what came out with what went in. Each char is looked for a little
+// way ahead, so a lost char costs one and a garbled one doesn't throw off
+// the rest.
+#define MATCH_AHEAD 16
+
+struct result {
+  long lost, garbled;
+  double avg_ms, max_ms;
+};
+
+static struct result match(struct seen *s, size_t n) {
+  struct result r = {0, 0, 0, 0};
+  size_t i = 0, j, k, matched = 0;
+  double ms, sum = 0;
+
+  for (j = 0; j < n; j++) {
+    for (k = i; (k < nexpected) && (k < i + MATCH_AHEAD); k++)
+      if ((expected[k].c == s[j].c) && (taken[expected[k].idx] <= s[j].t))
+        break;
+    if ((k >= nexpected) || (k >= i + MATCH_AHEAD)) {
+      r.garbled++;
+      continue;
+    }
+    r.lost += k - i;
+    ms = (s[j].t - taken[expected[k].idx]) / (double)SIM_MS;
+    sum += ms;
+    if (ms > r.max_ms)
+      r.max_ms = ms;
+    matched++;
+    i = k + 1;
+  }
+  r.lost += nexpected - i;
+  if (matched)
+    r.avg_ms = sum / matched;
+  return r;
+}
+
+static void flag_names(char *out, uint16_t flags) {
+  out[0] = 0;
+  if (flags & CONF_TRANSLATE)
+    strcat(out, "translate ");
+  else if (flags & CONF_8BIT)
+    strcat(out, "8bit ");
+  else
+    strcat(out, "raw ");
+  if (flags & CONF_CRLF)
+    strcat(out, "crlf ");
+  if (flags & CONF_AUTOCR)
+    strcat(out, "autocr ");
+  if (flags & CONF_WORDWRAP)
+    strcat(out, "wordwrap ");
+  if (flags & CONF_UNSHIFT_ON_SPACE)
+    strcat(out, "usos ");
+}
+
+static void report(int timed_out) {
+  struct result p = match(printed, nprinted);
+  struct result e = match(echoed, nechoed);
+  char name[64];
+  double secs, cps = 0;
+
+  secs = (nprinted ? printed[nprinted - 1].t - t_begin : 0) / (double)1e9;
+  if (secs > 0)
+    cps = (nprinted - p.garbled) / secs;
+  flag_names(name, run_flags);
+  fprintf(sim_out,
+          "%-32s %5zu %5ld %4ld %5ld %5ld %4ld %6.0f/%-6.0f %6.0f/%-6.0f "
+          "%5.2f%s\n",
+          name, nexpected, p.lost, p.garbled, tp.smeared, tp.margin, tp.fe,
+          p.avg_ms, p.max_ms, e.avg_ms, e.max_ms, cps,
+          timed_out ? "  timed out" : "");
+  if (e.lost || e.garbled)
+    fprintf(sim_out, "%32s echo: %ld lost, %ld garbled, %u rx framing errors, "
+                     "%u overruns\n",
+            "", e.lost, e.garbled, stats_framing_errors, stats_rx_overruns);
+  if (show_page) {
+    page[page_len] = 0;
+    fprintf(sim_out, "\n%s\n", page);
+  }
+  fflush(sim_out);
+  _exit(0);
+}
+
+void model_task(void) {
+  uint16_t divisor;
+
+  if (!configured) {
+    if (boot_state != BOOT_DONE)
+      return;
+    confflags = run_flags;
+    linewidth = adapter_width;
+    crfill = fill_n;
+    crfill_cols = fill_cols;
+    fillchar = fill_kind;
+    divisor = (uint16_t)(F_CPU / 64 / 3 / baud + 0.5);
+    set_softuart_divisor(divisor);
+    configured = 1;
+    t_begin = sim_now;
+    t_last_edge = sim_now;
+    // generously three times as long as it should take
+    t_limit = t_begin +
+              (sim_time_t)(3 * 11 * input_len * 1e9 / baud) + 30 * 1000 * SIM_MS;
+    sim_host_write(input, input_len);
+    return;
+  }
+  if (sim_now > t_limit)
+    report(1);
+  if (!sim_host_pending() && !tp.busy &&
+      (sim_now - t_last_edge > 3000 * SIM_MS))
+    report(0);
+}
+
+// text for the host to send: words out of a small vocabulary, on lines of
+// 10 to 100 chars so some of them need breaking
+static char *make_text(void) {
+  static const char *words[] = {
+      "the",  "quick", "brown", "fox",   "jumps", "over",  "lazy",
+      "dog",  "now",   "is",    "time",  "for",   "all",   "good",
+      "men",  "to",    "come",  "aid",   "of",    "party", "ryry",
+      "1234", "5.6",   "(7)",   "8/9",   "0-1",   "what?", "it's",
+      "tty:", "loop,", "teleprinter",   "carriage", "return"};
+  size_t nwords = sizeof(words) / sizeof(words[0]);
+  char *t = malloc(nchars + 128);
+  int len = 0, line = 0, linelen = 10 + rnd() % 91;
+  const char *w;
+
+  while (len < nchars) {
+    w = words[rnd() % nwords];
+    if (line && (line + 1 + (int)strlen(w) > linelen)) {
+      t[len++] = '\n';
+      line = 0;
+      linelen = 10 + rnd() % 91;
+    } else if (line) {
+      t[len++] = ' ';
+      line++;
+    }
+    strcpy(t + len, w);
+    len += strlen(w);
+    line += strlen(w);
+  }
+  t[len++] = '\n';
+  t[len] = 0;
+  return t;
+}
+
+static char *read_text(const char *name) {
+  FILE *f = fopen(name, "rb");
+  char *t;
+  long n;
+
+  if (f == NULL) {
+    perror(name);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  t = malloc(n + 1);
+  n = fread(t, 1, n, f);
+  t[n] = 0;
+  fclose(f);
+  return t;
+}
+
+static void add_expected(char c, size_t idx) {
+  expected[nexpected].c = c;
+  expected[nexpected].idx = idx;
+  nexpected++;
+}
+
+// What the host sends for this run: ASCII for translate and 8 bit, with
+// CR LF line ends unless the adapter adds the CR; Baudot codes for raw.
+static void make_input(const char *text) {
+  size_t n = strlen(text), i;
+  int shift = LTRS, want, code;
+  char c;
+
+  input = malloc(2 * n + 2);
+  expected = malloc((n + 1) * sizeof(*expected));
+  input_len = 0;
+  nexpected = 0;
+  for (i = 0; i < n; i++) {
+    c = text[i];
+    if (mode_translate() || mode_8bit()) {
+      if ((c == '\n') && !(mode_translate() && (run_flags & CONF_CRLF)))
+        input[input_len++] = '\r';
+      if (isgraph((unsigned char)c) &&
+          (mode_8bit() || (encode(toupper(c), &want) >= 0)))
+        add_expected(toupper(c), input_len);
+      input[input_len++] = c;
+      continue;
+    }
+    if (c == '\n') {
+      input[input_len++] = 0x08; // CR
+      input[input_len++] = 0x02; // LF
+      continue;
+    }
+    code = encode(toupper(c), &want);
+    if (code < 0)
+      continue;
+    if ((c != ' ') && (want != shift)) {
+      input[input_len++] = want;
+      shift = want;
+    }
+    if (isgraph((unsigned char)c))
+      add_expected(toupper(c), input_len);
+    input[input_len++] = code;
+    if ((c == ' ') && (run_flags & CONF_UNSHIFT_ON_SPACE))
+      shift = LTRS;
+  }
+  taken = calloc(input_len + 1, sizeof(*taken));
+  printed = malloc((input_len + 1) * sizeof(*printed));
+  echoed = malloc((input_len * 4 + 1) * sizeof(*echoed));
+  page = malloc(input_len * 4 + 2);
+}
+
+static void run(uint16_t flags, const char *text) {
+  run_flags = flags;
+  rnd_state = seed * 2654435761UL + flags + 1;
+  make_input(text);
+  tp.nbits = mode_8bit() ? 8 : 5;
+  tp.bit = (sim_time_t)(1e9 / baud / (1 + speed_err / 100));
+  tp.stop = (sim_time_t)(((stop_min >= 0) ? stop_min
+                                          : (mode_8bit() ? 1.0 : 1.42)) *
+                         tp.bit);
+  tp.usos = (flags & CONF_UNSHIFT_ON_SPACE) != 0;
+  tp.line = 1;
+  tp.shift = LTRS;
+  firmware_main();
+}
+
+static const struct {
+  const char *name;
+  uint16_t flag;
+} flagnames[] = {{"translate", CONF_TRANSLATE}, {"8bit", CONF_8BIT},
+                 {"raw", 0},                    {"crlf", CONF_CRLF},
+                 {"autocr", CONF_AUTOCR},       {"wordwrap", CONF_WORDWRAP},
+                 {"usos", CONF_UNSHIFT_ON_SPACE}};
+
+static int parse_flags(char *s) {
+  char *tok;
+  int i, flags = 0;
+
+  for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+    for (i = 0; i < (int)(sizeof(flagnames) / sizeof(flagnames[0])); i++)
+      if (!strcmp(tok, flagnames[i].name))
+        break;
+    if (i == (int)(sizeof(flagnames) / sizeof(flagnames[0]))) {
+      fprintf(stderr, "unknown config flag %s\n", tok);
+      exit(1);
+    }
+    flags |= flagnames[i].flag;
+  }
+  return flags;
+}
+
+static const uint16_t suite[] = {
+    CONF_TRANSLATE,
+    CONF_TRANSLATE | CONF_UNSHIFT_ON_SPACE,
+    CONF_TRANSLATE | CONF_CRLF,
+    CONF_TRANSLATE | CONF_CRLF | CONF_UNSHIFT_ON_SPACE,
+    CONF_TRANSLATE | CONF_AUTOCR,
+    CONF_TRANSLATE | CONF_AUTOCR | CONF_UNSHIFT_ON_SPACE,
+    CONF_TRANSLATE | CONF_CRLF | CONF_AUTOCR,
+    CONF_TRANSLATE | CONF_CRLF | CONF_AUTOCR | CONF_UNSHIFT_ON_SPACE,
+    CONF_TRANSLATE | CONF_CRLF | CONF_WORDWRAP,
+    CONF_TRANSLATE | CONF_CRLF | CONF_AUTOCR | CONF_WORDWRAP,
+    0,
+    CONF_UNSHIFT_ON_SPACE,
+    CONF_8BIT,
+};
+
+static void usage(const char *me) {
+  fprintf(stderr,
+          "usage: %s [-b baud] [-n chars | -f textfile] [-e speed%%]\n"
+          "          [-S stopbits] [-w cols] [-c base_ms,ms_per_col]\n"
+          "          [-l latency_us] [-j jitter_us] [-W adapter_width]\n"
+          "          [-F n[,cols[,ltrs|nul|gap]]] [-s seed]\n"
+          "          [-m flag,flag,...] [-p]\n",
+          me);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int opt, i, nruns;
+  int one = -1;
+  char *text, *p;
+  pid_t pid;
+
+  while ((opt = getopt(argc, argv, "b:n:f:e:S:w:c:l:j:W:F:s:m:p")) != -1) {
+    switch (opt) {
+    case 'b':
+      baud = atof(optarg);
+      break;
+    case 'n':
+      nchars = atoi(optarg);
+      break;
+    case 'f':
+      textfile = optarg;
+      break;
+    case 'e':
+      speed_err = atof(optarg);
+      break;
+    case 'S':
+      stop_min = atof(optarg);
+      stop_arg = optarg;
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'c':
+      cr_base = strtod(optarg, &p);
+      if (*p == ',')
+        cr_col = atof(p + 1);
+      break;
+    case 'l':
+      line_lat = atof(optarg);
+      break;
+    case 'j':
+      line_jitter = atof(optarg);
+      break;
+    case 'W':
+      adapter_width = atoi(optarg);
+      break;
+    case 'F':
+      fill_n = strtol(optarg, &p, 10);
+      if (*p == ',')
+        fill_cols = strtol(p + 1, &p, 10);
+      if (*p == ',')
+        fill_kind = !strcmp(p + 1, "gap") ? FILL_GAP
+                    : !strcmp(p + 1, "nul") ? FILL_NUL
+                                            : FILL_LTRS;
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'm':
+      one = parse_flags(optarg);
+      break;
+    case 'p':
+      show_page = 1;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if ((baud < 30) || (baud > 1200))
+    usage(argv[0]);
+
+  rnd_state = seed * 2654435761UL + 1;
+  text = textfile ? read_text(textfile) : make_text();
+
+  printf("%.2f baud, machine %+.1f%%, stop %s, %d cols, CR %.0f+%.1f "
+         "ms/col, line %.0f+-%.0f us, fill %d,%d,%s\n",
+         baud, speed_err, stop_arg, width, cr_base, cr_col, line_lat,
+         line_jitter, fill_n, fill_cols,
+         (fill_kind == FILL_GAP) ? "gap"
+         : (fill_kind == FILL_NUL) ? "nul"
+                                   : "ltrs");
+  printf("%-32s %5s %5s %4s %5s %5s %4s %13s %13s %5s\n", "config", "chars",
+         "lost", "garb", "smear", "margn", "fe", "print ms", "echo ms",
+         "cps");
+
+  // each run in its own process, so the firmware starts from reset
+  nruns = (one >= 0) ? 1 : (int)(sizeof(suite) / sizeof(suite[0]));
+  for (i = 0; i < nruns; i++) {
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      run((one >= 0) ? one : suite[i], text);
+      _exit(1); // firmware_main() doesn't return
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
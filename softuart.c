@@ -98,10 +98,18 @@ V0.3
 #include "pins.h"
 #include "softuart.h"
 #include "conf.h"
+#include "out.h"
+#include "stats.h"
+#include "tick.h"
+#ifdef INCLUDE_HWUART
+#include "hwuart.h"
+#endif
 #include <avr/delay.h>
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <ctype.h>
+#include <stdio.h>
 
 #define SU_TRUE 1
 #define SU_FALSE 0
@@ -112,6 +120,20 @@ volatile static unsigned char qin = 0;
 volatile static unsigned char qout = 0;
 volatile static unsigned char flag_rx_off;
 volatile static unsigned char flag_rx_ready;
+// SOFTUART_ flags of each inbuf char
+volatile static uint8_t inflags[SOFTUART_IN_BUF_SIZE];
+#ifdef INCLUDE_CAPTURE
+// when each inbuf char finished arriving (low 16 bits of millis()). Only
+// needed for capture mode.
+volatile static uint16_t intime[SOFTUART_IN_BUF_SIZE];
+#endif
+#ifdef INCLUDE_LOGIC
+// raw RX pin samples for logic analyzer mode, 8 per byte, oldest in the MSB
+volatile static uint8_t labuf[SOFTUART_LA_BUF_SIZE];
+volatile static unsigned char la_in = 0;
+volatile static unsigned char la_out = 0;
+volatile static unsigned char flag_la_on = SU_FALSE;
+#endif
 
 // 1 Startbit, 8 Databits, 1 Stopbit = 10 Bits/Frame
 // or for teletype, 1 start, 5 data, 2 stop = 8 bits/frame
@@ -120,8 +142,14 @@ volatile uint8_t framing_error = 0; // epv
 
 #define TX_NUM_OF_BITS (txbits)
 #define RX_NUM_OF_BITS (rxbits)
-volatile unsigned char flag_tx_ready;
-extern uint8_t confflags; // epv
+volatile unsigned char flag_tx_ready; // char going out, or more queued
+extern uint16_t confflags; // epv
+
+// chars waiting to go out; the ISR starts the next one as soon as the
+// previous one's stop bits are done
+volatile static char txbuf[SOFTUART_TX_BUF_SIZE];
+volatile static unsigned char tx_qin = 0;
+volatile static unsigned char tx_qout = 0;
 
 // volatile static unsigned char  flag_tx_ready;
 volatile static unsigned char timer_tx_ctr;
@@ -170,26 +198,275 @@ int8_t get_rx_pin_status(void) {
 //#define get_rx_pin_status()    (!( SOFTUART_RXPIN  & ( 1<<SOFTUART_RXBIT ) ))
 //// opto
 
-ISR(SOFTUART_T_COMP_LABEL) {
-  static unsigned char flag_rx_waiting_for_stop_bit = SU_FALSE;
-  static unsigned char rx_mask;
+// The receiver works off edges rather than sampling at 3x baud: a pin
+// change interrupt on the RX pin timestamps every transition with Timer3
+// (free running at F_CPU/64, 4us), and each bit is whatever level the line
+// had at its middle. A Timer3 compare at the middle of the stop bit finishes
+// the frame, since the last bits may not have an edge. An idle line costs
+// the receiver no interrupts; the 1ms tick (tick.c) still runs, since it's
+// what wakes main() to poll USB. Bit times come from OCR1A, so "baud" sets
+// both directions; 16 bit timestamps cover a frame down to about 37 baud.
+static uint16_t rx_t0;        // Timer3 at the start edge
+static uint16_t rx_bit;       // one bit in Timer3 counts
+static uint16_t rx_sample;    // next sample point, counts after rx_t0
+static unsigned char rx_next; // next bit to sample, 0 is the start bit
+static unsigned char rx_data;
+static unsigned char rx_level = 1; // line level since the last edge, 1 = mark
+
+// On a loop that brings back what we send, the receiver gets each frame a
+// moment after its start bit went out. Frames sent are kept here with their
+// start time until their echo shows up: Timer3 to match it to the edge, and
+// millis() too, since Timer3 wraps every 262ms and a frame at 45 baud is
+// 154ms long.
+static char echo_code[SOFTUART_ECHO_WINDOW];
+static uint16_t echo_t0[SOFTUART_ECHO_WINDOW];
+static uint32_t echo_ms[SOFTUART_ECHO_WINDOW];
+static uint32_t rx_ms; // millis() at the start edge
+static unsigned char echo_out = 0;
+static unsigned char echo_n = 0;
+static char tx_code; // the frame going out now
+
+#ifdef INCLUDE_AUTOBAUD
+// pulse widths for autobaud, see softuart_pulses()
+volatile static uint32_t pulsebuf[SOFTUART_PULSE_BUF_SIZE];
+volatile static unsigned char pulse_in = 0;
+volatile static unsigned char pulse_out = 0;
+volatile static unsigned char flag_pulses_on = SU_FALSE;
+volatile static uint16_t pulse_wraps;
+static uint32_t pulse_last;
+
+ISR(TIMER3_OVF_vect) { pulse_wraps++; }
+
+static void pulse_edge(uint16_t now) {
+  uint16_t wraps = pulse_wraps;
+  uint32_t t;
+  unsigned char next;
+
+  // an overflow that happened just now hasn't been counted yet
+  if ((TIFR3 & _BV(TOV3)) && (now < 0x8000))
+    wraps++;
+  t = ((uint32_t)wraps << 16) | now;
+  next = pulse_in + 1;
+  if (next >= SOFTUART_PULSE_BUF_SIZE)
+    next = 0;
+  if (next != pulse_out) {
+    pulsebuf[pulse_in] = (t - pulse_last) | (rx_level ? SOFTUART_PULSE_MARK : 0);
+    pulse_in = next;
+  }
+  pulse_last = t;
+}
+#endif
+
+// take every sample that falls before elapsed counts into the frame; the
+// line has been at rx_level for all of them
+static void rx_fill(uint16_t elapsed) {
+  while ((rx_next <= RX_NUM_OF_BITS) && (elapsed >= rx_sample)) {
+    if (rx_next && rx_level)
+      rx_data |= 1 << (rx_next - 1);
+    rx_next++;
+    rx_sample += rx_bit;
+  }
+}
+
+static void rx_abort(void) {
+  TIMSK3 &= ~_BV(OCIE3A);
+  flag_rx_ready = SU_FALSE;
+}
+
+ISR(PCINT0_vect) {
+  uint16_t now = TCNT3;
+  unsigned char level = get_rx_pin_status() ? 1 : 0;
+
+  if (level == rx_level)
+    return; // bounced, or another pin on the port
+#ifdef INCLUDE_AUTOBAUD
+  if (flag_pulses_on)
+    pulse_edge(now);
+#endif
 
-  static char timer_rx_ctr;
-  static char bits_left_in_rx;
-  static unsigned char internal_rx_buffer;
+  if (flag_rx_off) {
+    rx_abort();
+  } else if (flag_rx_ready == SU_FALSE) {
+    if (level == 0) { // start bit
+      flag_rx_ready = SU_TRUE;
+      rx_t0 = now;
+      rx_ms = millis();
+      rx_bit = 3 * (OCR1A + 1); // Timer1 CTC period is OCR1A + 1
+      rx_sample = rx_bit / 2;
+      rx_next = 0;
+      rx_data = 0;
+      OCR3A = now + rx_sample + (RX_NUM_OF_BITS + 1) * rx_bit;
+      TIFR3 = _BV(OCF3A);
+      TIMSK3 |= _BV(OCIE3A);
+    } else
+      framing_error = 0; // back to mark, any break is over
+  } else {
+    rx_fill(now - rx_t0);
+    if (rx_next == 0) // gone before the middle of the start bit, noise
+      rx_abort();
+  }
+  rx_level = level;
+}
 
-  char start_bit, flag_in;
+static void echo_drop(void) {
+  if (++echo_out >= SOFTUART_ECHO_WINDOW)
+    echo_out = 0;
+  echo_n--;
+}
+
+// Is the frame just received one of ours? One that went out more than half
+// a bit before this started lost its echo: if it was still on the line,
+// someone else's start bit came first and this frame is the mess the two
+// made. One that went out within half a bit of it should be this. One that
+// went out later is still to come, but started while this was on the line.
+// Returns SOFTUART_ECHO or SOFTUART_COLLISION, or 0 for someone else's frame
+// on a quiet line. Each frame of ours that didn't come back intact is
+// counted once.
+static unsigned char echo_match(unsigned char rx_flags) {
+  int16_t d = 0;
+  int16_t half = rx_bit / 2;
+  int32_t ms;
+  uint16_t frame = (uint32_t)(RX_NUM_OF_BITS + 2) * rx_bit / 250 + 1; // ms
+  unsigned char mask = (1 << RX_NUM_OF_BITS) - 1;
+  unsigned char lost = 0;
+  char code;
+
+  while (echo_n) {
+    ms = rx_ms - echo_ms[echo_out];
+    if (ms > 100) // too far apart for Timer3 to say
+      d = INT16_MAX;
+    else if (ms < -100)
+      d = INT16_MIN;
+    else
+      d = rx_t0 - echo_t0[echo_out];
+    if (d <= half)
+      break;
+    echo_drop();
+    if (confflags & CONF_HALFDUPLEX)
+      stats_collisions++;
+    if (ms < frame) // still going out when this started
+      lost = SOFTUART_COLLISION;
+  }
+  if (!echo_n)
+    return lost;
+  if (d < -half)
+    return SOFTUART_COLLISION;
+  code = echo_code[echo_out];
+  echo_drop();
+  if (!rx_flags && (((code ^ rx_data) & mask) == 0))
+    return SOFTUART_ECHO;
+  if (confflags & CONF_HALFDUPLEX)
+    stats_collisions++;
+  return SOFTUART_COLLISION;
+}
+
+// middle of the stop bit
+ISR(TIMER3_COMPA_vect) {
+  unsigned char next, rx_flags;
+
+  rx_abort();
+  if (flag_rx_off)
+    return;
+  rx_fill(TCNT3 - rx_t0);
+
+  // the stop bit should be a mark. An all-zero char with no stop bit is a
+  // break, counted in main().
+  rx_flags = 0;
+  if (!rx_level) {
+    if (rx_data) {
+      stats_framing_errors++;
+      rx_flags = SOFTUART_FE;
+    } else
+      rx_flags = SOFTUART_BREAK;
+  }
+  framing_error = (rx_flags == SOFTUART_BREAK);
+  rx_flags |= echo_match(rx_flags);
+
+  next = qin + 1;
+  if (next >= SOFTUART_IN_BUF_SIZE)
+    next = 0;
+  if (next == qout) {
+    // inbuf full, drop this char rather than wrap onto unread ones
+    stats_rx_overruns++;
+  } else {
+    inbuf[qin] = rx_data;
+    inflags[qin] = rx_flags;
+#ifdef INCLUDE_CAPTURE
+    intime[qin] = millis();
+#endif
+    qin = next;
+  }
+}
+
+// Timer1 only runs the transmitter (and logic analyzer mode) now, so it's
+// only enabled while one of them has something to do.
+ISR(SOFTUART_T_COMP_LABEL) {
   char tmp;
+  unsigned char slot;
+#ifdef INCLUDE_LOGIC
+  unsigned char next;
+  static unsigned char la_bits, la_count;
+
+  // Logic analyzer: one sample of the RX pin per tick, i.e. 3x baud.
+  if (flag_la_on) {
+    la_bits = (la_bits << 1) | (get_rx_pin_status() ? 1 : 0);
+    if (++la_count >= 8) {
+      la_count = 0;
+      next = la_in + 1;
+      if (next >= SOFTUART_LA_BUF_SIZE)
+        next = 0;
+      if (next == la_out) {
+        stats_rx_overruns++;
+      } else {
+        labuf[la_in] = la_bits;
+        la_in = next;
+      }
+    }
+  }
+#endif
 
   // Transmitter Section
+  if (flag_tx_ready && (bits_left_in_tx == 0)) {
+    if (tx_qout == tx_qin) {
+      flag_tx_ready = SU_FALSE;
+    } else {
+      // invoke_UART_transmit
+      tmp = txbuf[tx_qout];
+      tx_code = tmp;
+      if (++tx_qout >= SOFTUART_TX_BUF_SIZE)
+        tx_qout = 0;
+      timer_tx_ctr = 3;
+      // bits_left_in_tx includes 1 start + 2 stop bits,
+      // so should be 8 for teletype.
+      bits_left_in_tx = TX_NUM_OF_BITS;
+      // word = Start, data, then stop bits from there up. For teletype
+      // that's data 1-5, Stop, Stop.
+      internal_tx_buffer =
+          ((unsigned char)tmp << 1) | (0xFFFF << (RX_NUM_OF_BITS + 1));
+    }
+  }
   if (flag_tx_ready) {
-    if (!(confflags & CONF_8BIT))
+    if (RX_NUM_OF_BITS < 7) // 1.5 stop bits
       if ((bits_left_in_tx == 1) &&
           (timer_tx_ctr == 2)) // short circuit state machine for tty use
         timer_tx_ctr = 1;
 
     tmp = timer_tx_ctr;
     if (--tmp <= 0) { // if ( --timer_tx_ctr <= 0 )
+      if (bits_left_in_tx == TX_NUM_OF_BITS) { // start bit, expect an echo
+        if (echo_n == SOFTUART_ECHO_WINDOW) {
+          echo_drop();
+          if (confflags & CONF_HALFDUPLEX)
+            stats_collisions++;
+        }
+        slot = echo_out + echo_n;
+        if (slot >= SOFTUART_ECHO_WINDOW)
+          slot -= SOFTUART_ECHO_WINDOW;
+        echo_code[slot] = tx_code;
+        echo_t0[slot] = TCNT3;
+        echo_ms[slot] = millis();
+        echo_n++;
+      }
       if (internal_tx_buffer & 0x01) {
         set_tx_pin_high();
       } else {
@@ -197,59 +474,19 @@ ISR(SOFTUART_T_COMP_LABEL) {
       }
       internal_tx_buffer >>= 1;
       tmp = 3; // timer_tx_ctr = 3;
-      if (--bits_left_in_tx <= 0) {
-        flag_tx_ready = SU_FALSE;
-      }
+      // when this gets to 0 the next tick starts the next queued char,
+      // or clears flag_tx_ready
+      --bits_left_in_tx;
     }
     timer_tx_ctr = tmp;
   }
 
-  // Receiver Section
-  if (flag_rx_off == SU_FALSE) {
-    if (flag_rx_waiting_for_stop_bit) {
-      if (--timer_rx_ctr <= 0) {
-        flag_rx_waiting_for_stop_bit = SU_FALSE;
-        flag_rx_ready = SU_FALSE;
-        inbuf[qin] = internal_rx_buffer;
-        if (++qin >= SOFTUART_IN_BUF_SIZE) {
-          // overflow - rst inbuf-index
-          qin = 0;
-        }
-      } else // test for break condition -- EPV
-        // if ((internal_rx_buffer == 0) && (get_rx_pin_status() == 0))
-        // framing_error = 1; this fails to distinguish a null char from a break
-        // but so does a real tty, i guess
-        if ((internal_rx_buffer == 0))
-          framing_error = 1;
-        else
-          framing_error = 0;
-    } else { // rx_test_busy
-      if (flag_rx_ready == SU_FALSE) {
-        start_bit = get_rx_pin_status();
-        // test for start bit
-        if (start_bit == 0) {
-          flag_rx_ready = SU_TRUE;
-          internal_rx_buffer = 0;
-          timer_rx_ctr = 4;
-          bits_left_in_rx = RX_NUM_OF_BITS;
-          rx_mask = 1;
-        }
-      } else { // rx_busy
-        if (--timer_rx_ctr <= 0) {
-          // rcv
-          timer_rx_ctr = 3;
-          flag_in = get_rx_pin_status();
-          if (flag_in) {
-            internal_rx_buffer |= rx_mask;
-          }
-          rx_mask <<= 1;
-          if (--bits_left_in_rx <= 0) {
-            flag_rx_waiting_for_stop_bit = SU_TRUE;
-          }
-        }
-      }
-    }
-  }
+#ifdef INCLUDE_LOGIC
+  if (!flag_tx_ready && !flag_la_on)
+#else
+  if (!flag_tx_ready)
+#endif
+    SOFTUART_T_INTCTL_REG &= ~SOFTUART_CMPINT_EN_MASK;
 }
 static void avr_io_init(void) {
   // TX-Pin as output (and indicator light)
@@ -280,10 +517,16 @@ static void avr_timer_init(void) {
   TCCR1A = 0;
   TCCR1B =
       _BV(WGM12) | _BV(CS11) | _BV(CS10); // WGM=CTC mode, clk prescale = /64
-  // TIMSK1 |= TIMSK1 |= _BV(OCIE1A)|_BV(TOIE1); // How did this ever even
-  // work??? Wtf
-  TIMSK1 |= _BV(OCIE1A) | _BV(TOIE1);
+  // only interrupts while sending, see softuart_putchar()
+  TIMSK1 &= ~(_BV(OCIE1A) | _BV(TOIE1));
   TCNT1 = 0;
+
+  // Timer3 free runs at clk/64 to timestamp RX edges
+  TCCR3A = 0;
+  TCCR3B = _BV(CS31) | _BV(CS30);
+  PCMSK0 |= _BV(SOFTUART_RXBIT);
+  PCIFR = _BV(PCIF0);
+  PCICR |= _BV(PCIE0);
 }
 void softuart_init(void) {
   flag_tx_ready = SU_FALSE;
@@ -302,15 +545,34 @@ static void idle(void) {
   // timeout handling goes here
   // - but there is a "softuart_kbhit" in this code...
   // add watchdog-reset here if needed
+#ifdef SOFTUART_IDLE_HOOK
+  SOFTUART_IDLE_HOOK(); // the host simulator lets time pass, see sim/
+#endif
 }
 
-void softuart_turn_rx_on(void) { flag_rx_off = SU_FALSE; }
+void softuart_turn_rx_on(void) {
+  flag_rx_off = SU_FALSE;
+#ifdef INCLUDE_HWUART
+  hwuart_rx(1);
+#endif
+}
 
-void softuart_turn_rx_off(void) { flag_rx_off = SU_TRUE; }
+void softuart_turn_rx_off(void) {
+  flag_rx_off = SU_TRUE;
+#ifdef INCLUDE_HWUART
+  hwuart_rx(0);
+#endif
+}
 
+// With INCLUDE_HWUART the rest of the API passes through to hwuart.c when
+// the USART has been selected ("uart hw").
 char softuart_getchar(void) {
   char ch;
 
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    return hwuart_getchar();
+#endif
   if (qout == qin)
     return (0);
 
@@ -323,32 +585,143 @@ char softuart_getchar(void) {
   return (ch);
 }
 
-unsigned char softuart_kbhit(void) { return (qin != qout); }
+uint8_t softuart_peekflags(void) {
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    return hwuart_peekflags();
+#endif
+  if (qout == qin)
+    return (0);
+  return (inflags[qout]);
+}
+
+#ifdef INCLUDE_CAPTURE
+// like softuart_getchar(), but also says when the char arrived (low 16 bits
+// of millis()) and how it was framed (SOFTUART_FE, SOFTUART_BREAK).
+char softuart_getframe(uint16_t *time, uint8_t *flags) {
+  char ch;
+
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    return hwuart_getframe(time, flags);
+#endif
+  if (qout == qin)
+    return (0);
+
+  ch = inbuf[qout];
+  *time = intime[qout];
+  *flags = inflags[qout];
+
+  if (++qout >= SOFTUART_IN_BUF_SIZE) {
+    qout = 0;
+  }
+
+  return (ch);
+}
+#endif
+
+#ifdef INCLUDE_LOGIC
+// Start or stop streaming raw RX samples into labuf.
+void softuart_logic(unsigned char on) {
+  flag_la_on = SU_FALSE;
+  la_in = 0;
+  la_out = 0;
+  flag_la_on = on ? SU_TRUE : SU_FALSE;
+  if (on)
+    SOFTUART_T_INTCTL_REG |= SOFTUART_CMPINT_EN_MASK;
+}
+
+// Get the next 8 samples, oldest in the MSB, 1 = mark. Returns FALSE if
+// there aren't 8 new ones yet.
+unsigned char softuart_logic_get(uint8_t *samples) {
+  if (la_out == la_in)
+    return (SU_FALSE);
+  *samples = labuf[la_out];
+  if (++la_out >= SOFTUART_LA_BUF_SIZE)
+    la_out = 0;
+  return (SU_TRUE);
+}
+#endif
+
+#ifdef INCLUDE_AUTOBAUD
+// Start or stop recording the width of every pulse on the RX pin, for
+// autobaud. Runs alongside the receiver.
+void softuart_pulses(unsigned char on) {
+  flag_pulses_on = SU_FALSE;
+  pulse_in = 0;
+  pulse_out = 0;
+  pulse_wraps = 0;
+  pulse_last = TCNT3;
+  TIFR3 = _BV(TOV3);
+  if (on) {
+    TIMSK3 |= _BV(TOIE3);
+    flag_pulses_on = SU_TRUE;
+  } else
+    TIMSK3 &= ~_BV(TOIE3);
+}
+
+// Get the next pulse width in Timer3 counts (F_CPU/64), with
+// SOFTUART_PULSE_MARK set if it was a mark. Returns FALSE if there isn't one.
+unsigned char softuart_pulse_get(uint32_t *width) {
+  if (pulse_out == pulse_in)
+    return (SU_FALSE);
+  *width = pulsebuf[pulse_out];
+  if (++pulse_out >= SOFTUART_PULSE_BUF_SIZE)
+    pulse_out = 0;
+  return (SU_TRUE);
+}
+#endif
+
+unsigned char softuart_kbhit(void) {
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    return hwuart_kbhit();
+#endif
+  return (qin != qout);
+}
 
 void softuart_flush_input_buffer(void) {
+#ifdef INCLUDE_HWUART
+  hwuart_flush_input_buffer();
+#endif
   qin = 0;
   qout = 0;
 }
 
 unsigned char softuart_can_transmit(void) { return (flag_tx_ready); }
 
+// How many more chars softuart_putchar() will take without waiting.
+unsigned char softuart_tx_free(void) {
+  unsigned char used;
+
+#ifdef INCLUDE_HWUART
+  if (hwuart_on)
+    return hwuart_tx_free();
+#endif
+  used = tx_qin - tx_qout;
+  if (used >= SOFTUART_TX_BUF_SIZE) // wrapped
+    used += SOFTUART_TX_BUF_SIZE;
+  return (SOFTUART_TX_BUF_SIZE - 1 - used);
+}
+
 void softuart_putchar(const char ch) {
-  while (flag_tx_ready) {
-    ; // wait for transmitter ready
-      // add watchdog-reset here if needed;
+#ifdef INCLUDE_HWUART
+  if (hwuart_on) {
+    hwuart_putchar(ch);
+    return;
+  }
+#endif
+  while (softuart_tx_free() == 0) {
+    idle(); // wait for room in the queue
   }
 
-  // invoke_UART_transmit
-  timer_tx_ctr = 3;
-  // bits_left_in_tx includes 1 start + 2 stop bits,
-  // so should be 8 for teletype.
-  bits_left_in_tx = TX_NUM_OF_BITS;
-  if (confflags & CONF_8BIT)
-    internal_tx_buffer = (ch << 1) | 0x200;
-  else
-    // for teletype, word = Start, data 1-5, Stop, Stop
-    internal_tx_buffer = (ch << 1) | 0xC0;
+  stats.tx_chars++;
+
+  txbuf[tx_qin] = ch;
+  if (++tx_qin >= SOFTUART_TX_BUF_SIZE)
+    tx_qin = 0;
   flag_tx_ready = SU_TRUE;
+  SOFTUART_T_INTCTL_REG |= SOFTUART_CMPINT_EN_MASK;
 }
 
 void softuart_puts(const char *s) {
@@ -369,15 +742,24 @@ char baudot_to_ascii(char);
 void softuart_status(void) {
   uint8_t i;
   char ascii_char;
-  printf("%u %u ", qin, qout);
+  out_dec(qin);
+  out_char(' ');
+  out_dec(qout);
+  out_char(' ');
   for (i = 0; i < SOFTUART_IN_BUF_SIZE; i++) {
     ascii_char = baudot_to_ascii(inbuf[i]);
-    printf("%c", isprint(ascii_char) ? ascii_char : '.');
+    out_char(isprint(ascii_char) ? ascii_char : '.');
   }
-  printf("\r\n");
+  out_crlf();
 }
 
 void send_break(void) {
+#ifdef INCLUDE_HWUART
+  if (hwuart_on) {
+    hwuart_send_break();
+    return;
+  }
+#endif
   softuart_turn_rx_off();
   set_tx_pin_low();
   _delay_ms(500);
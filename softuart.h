@@ -37,6 +37,9 @@
 #endif
 
 #define SOFTUART_IN_BUF_SIZE 32
+#define SOFTUART_LA_BUF_SIZE 64
+#define SOFTUART_PULSE_BUF_SIZE 16
+#define SOFTUART_TX_BUF_SIZE 32
 
 // Init the Software Uart
 void softuart_init(void);
@@ -50,9 +53,43 @@ unsigned char softuart_kbhit(void);
 // Reads a character from the input buffer, waiting if necessary.
 char softuart_getchar(void);
 
+// SOFTUART_ flags of the character softuart_getchar() returns next.
+uint8_t softuart_peekflags(void);
+
+// per character receive flags, see softuart_getframe()
+#define SOFTUART_FE (1 << 0)    // stop bit was a space
+#define SOFTUART_BREAK (1 << 1) // all space, no stop bit
+#define SOFTUART_ECHO (1 << 4)  // a frame we sent, come back intact
+#define SOFTUART_COLLISION (1 << 5) // ours and someone else's at once
+
+// how many frames we can still be waiting to hear back, see echo_match()
+#define SOFTUART_ECHO_WINDOW 4
+
+#ifdef INCLUDE_CAPTURE
+// Reads a character along with when it arrived and its SOFTUART_ flags.
+char softuart_getframe(uint16_t *time, uint8_t *flags);
+#endif
+
+#ifdef INCLUDE_LOGIC
+// Logic analyzer mode: the timer ISR records the RX pin on every tick
+// (3x baud) and packs 8 samples per byte.
+void softuart_logic(unsigned char on);
+unsigned char softuart_logic_get(uint8_t *samples);
+#endif
+
+#ifdef INCLUDE_AUTOBAUD
+// Pulse widths on the RX pin, in F_CPU/64 counts, for autobaud.
+#define SOFTUART_PULSE_MARK 0x80000000UL
+void softuart_pulses(unsigned char on);
+unsigned char softuart_pulse_get(uint32_t *width);
+#endif
+
 // To check if transmitter is busy
 unsigned char softuart_can_transmit(void);
 
+// Room left in the transmit queue.
+unsigned char softuart_tx_free(void);
+
 // Writes a character to the serial port.
 void softuart_putchar(const char);
 
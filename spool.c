@@ -0,0 +1,95 @@
+/* Holding host text while the loop is down.
+ *
+ * With the spool flag, main() decides when the loop can't print: the relays
+ * are off on a unit wired for them, or the loop has been open (a break that
+ * doesn't end) for SPOOL_OPEN_MS. Until it's back, what the host sends goes
+ * here instead of to softuart_putchar(), where it would be lost, and once it
+ * is, it goes out as if the host had just sent it, before anything newer.
+ * Scheduled messages and held UTF-8 output don't run at all meanwhile.
+ *
+ * The first SPOOL_RAM chars are kept in RAM; after that they go in the top
+ * EEP_SPOOL_SIZE bytes of the eeprom, which only get written during a long
+ * outage. Those are the end of the autoprint message's space, so they're
+ * only used if the saved message ends (its 0xFF) before EEP_SPOOL_START;
+ * with a longer one, like one saved before there was a spool, it keeps to
+ * RAM. That's looked at again at the start of every outage. The indices are
+ * in RAM, so a reset loses the lot. Once it's full main() stops taking from
+ * the host, so it blocks, unless the relays are what's off: then it has to
+ * keep reading to see DC2, and the rest is counted as lost. */
+
+#include "spool.h"
+#include "conf.h"
+#include "stats.h"
+#include <avr/eeprom.h>
+#include <avr/io.h>
+
+static char ram[SPOOL_RAM];
+static uint16_t ram_head = 0, ram_tail = 0, ram_n = 0;
+static uint8_t eep_head = 0, eep_tail = 0, eep_n = 0;
+static uint8_t eep_checked = 0;
+
+// EEP_SPOOL_SIZE, or 0 if the autoprint message runs into the overflow
+static uint8_t eep_size(void) {
+#ifdef INCLUDE_AUTOPRINT
+  static uint8_t room;
+  uint16_t a;
+
+  if (!eep_checked) {
+    eep_checked = 1;
+    room = 0;
+    for (a = EEP_AUTOMSG_START; a < EEP_SPOOL_START; a++)
+      if (eeprom_read_byte((const uint8_t *)a) == 0xFF) {
+        room = EEP_SPOOL_SIZE;
+        break;
+      }
+  }
+  return room;
+#else
+  return EEP_SPOOL_SIZE;
+#endif
+}
+
+// Chars only go in the eeprom while it holds any, so they all came after
+// what's in RAM, and RAM empties first.
+void spool_put(char c) {
+  if (!spool_len())
+    eep_checked = 0; // a new outage, the message may have changed
+  if (!eep_n && (ram_n < SPOOL_RAM)) {
+    ram[ram_head] = c;
+    ram_head = (ram_head + 1) % SPOOL_RAM;
+    ram_n++;
+  } else if (eep_n < eep_size()) {
+    eeprom_write_byte((uint8_t *)(EEP_SPOOL_START + eep_head), c);
+    eep_head = (eep_head + 1) % EEP_SPOOL_SIZE;
+    eep_n++;
+  } else {
+    stats.spool_lost++;
+    return;
+  }
+  if (spool_len() > stats.spool_peak)
+    stats.spool_peak = spool_len();
+}
+
+char spool_next(void) {
+  char c;
+
+  if (ram_n) {
+    c = ram[ram_tail];
+    ram_tail = (ram_tail + 1) % SPOOL_RAM;
+    ram_n--;
+    return c;
+  }
+  if (!eep_n)
+    return 0;
+  c = eeprom_read_byte((const uint8_t *)(EEP_SPOOL_START + eep_tail));
+  eep_tail = (eep_tail + 1) % EEP_SPOOL_SIZE;
+  eep_n--;
+  return c;
+}
+
+uint16_t spool_len(void) { return ram_n + eep_n; }
+
+// what it holds at most, RAM and eeprom
+uint16_t spool_size(void) { return SPOOL_RAM + eep_size(); }
+
+uint8_t spool_full(void) { return spool_len() >= spool_size(); }
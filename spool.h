@@ -0,0 +1,19 @@
+// Host text held while the loop is down, see spool.c.
+
+#ifndef _SPOOL_H_
+#define _SPOOL_H_
+
+#include "conf.h"
+#include <stdint.h>
+
+#define SPOOL_RAM 256
+#define SPOOL_OPEN_MS 2000 // a break this long is an open loop
+#define SPOOL_SETTLE_MS 1000 // and it's closed again after this much mark
+
+void spool_put(char c);
+char spool_next(void);
+uint16_t spool_len(void);
+uint16_t spool_size(void);
+uint8_t spool_full(void);
+
+#endif
@@ -0,0 +1,136 @@
+/* Per direction traffic, error and latency counters, for the "stats"
+ * command.
+ *
+ * USB traffic is counted in bytes, not packets: LUFA's CDC driver packs
+ * bytes into endpoint banks itself and sends a bank when it's full or at the
+ * next CDC_Device_USBTask(), so the firmware never sees where one packet
+ * ends. Every byte to the host goes through out_char(), usb_serial_putchar()
+ * or rxout.c's writes, which all count it; every byte from it is taken in
+ * main() and counted by stats_host_taken(). */
+
+#include "stats.h"
+#include "baudot.h"
+#include "lufa_serial.h"
+#include "out.h"
+#include "profile.h"
+#include "spool.h"
+#include "tick.h"
+#include <avr/pgmspace.h>
+#include <string.h>
+#include <util/atomic.h>
+
+extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface;
+extern uint8_t baudot_shift_send; // from baudot.c
+extern uint8_t baudot_shift_rcv;  // from baudot.c
+
+struct stats stats;
+volatile uint16_t stats_framing_errors = 0;
+volatile uint16_t stats_rx_overruns = 0;
+volatile uint16_t stats_collisions = 0;
+
+// when the oldest byte still sitting in the OUT endpoint was first seen
+static uint32_t pending_since;
+static uint8_t pending = 0;
+
+// Called each trip around the main loop, so we notice when the host has
+// data waiting that we aren't ready to take yet.
+void stats_host_pending(void) {
+  if (!pending && CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface)) {
+    pending_since = millis();
+    pending = 1;
+  }
+}
+
+// Called after taking a byte from the host.
+void stats_host_taken(void) {
+  uint32_t waited;
+
+  stats.usb_out_bytes++;
+  if (pending) {
+    waited = millis() - pending_since;
+    if (waited > 0xFFFF)
+      waited = 0xFFFF;
+    if (waited > stats.max_latency)
+      stats.max_latency = waited;
+  }
+  // the rest of the packet has been waiting just as long, so only restart
+  // the clock once the endpoint is empty.
+  if (!CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface))
+    pending = 0;
+}
+
+void stats_reset(void) {
+  memset(&stats, 0, sizeof(stats));
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    stats_framing_errors = 0;
+    stats_rx_overruns = 0;
+    stats_collisions = 0;
+  }
+  pending = 0;
+}
+
+static const char *shift_name(uint8_t shift) {
+  return (shift == LTRS) ? PSTR("LTRS") : (shift == FIGS) ? PSTR("FIGS")
+                                                          : PSTR("?");
+}
+
+// one "label:   value" line
+static void stats_line(PGM_P label, uint32_t v) {
+  out_str_P(label);
+  out_dec(v);
+  out_crlf();
+}
+
+void stats_print(void) {
+  uint16_t framing, overruns, collisions;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    framing = stats_framing_errors;
+    overruns = stats_rx_overruns;
+    collisions = stats_collisions;
+  }
+  stats_line(PSTR("loop rx chars:    "), stats.rx_chars);
+  stats_line(PSTR("loop tx chars:    "), stats.tx_chars);
+  stats_line(PSTR("shifts inserted:  "), stats.shifts);
+  stats_line(PSTR("untranslatable:   "), stats.dropped);
+  stats_line(PSTR("shift resyncs:    "), stats.resyncs);
+  stats_line(PSTR("keyboard shifts:  "), stats.heard_shifts);
+  out_str_P(PSTR("shift tx/rx:      "));
+  out_str_P(shift_name(baudot_shift_send));
+  out_char(' ');
+  out_str_P(shift_name(baudot_shift_rcv));
+  out_crlf();
+  out_str_P(PSTR("profile:          "));
+  out_dec(profile_cur);
+  out_str_P(PSTR(" (table "));
+  out_dec(profile_table[profile_cur]);
+  out_str_P(PSTR(", "));
+  out_dec(profile_width[profile_cur]);
+  out_str_P(PSTR(" bit), "));
+  out_dec(stats.profiles);
+  out_str_P(PSTR(" switches"));
+  out_crlf();
+  stats_line(PSTR("scheduled msgs:   "), stats.scheduled);
+  stats_line(PSTR("framing errors:   "), framing);
+  stats_line(PSTR("breaks:           "), stats.breaks);
+  stats_line(PSTR("loop outages:     "), stats.outages);
+  out_str_P(PSTR("spooled:          "));
+  out_dec(spool_len());
+  out_char('/');
+  out_dec(spool_size());
+  out_str_P(PSTR(", peak "));
+  out_dec(stats.spool_peak);
+  out_str_P(PSTR(", lost "));
+  out_dec(stats.spool_lost);
+  out_crlf();
+  stats_line(PSTR("rx overruns:      "), overruns);
+  stats_line(PSTR("collisions:       "), collisions);
+  stats_line(PSTR("echoes dropped:   "), stats.echoes);
+  stats_line(PSTR("usb out bytes:    "), stats.usb_out_bytes);
+  stats_line(PSTR("usb in bytes:     "), stats.usb_in_bytes);
+  stats_line(PSTR("usb in stalls:    "), stats.usb_in_stalls);
+  out_str_P(PSTR("max host latency: "));
+  out_dec(stats.max_latency);
+  out_str_P(PSTR(" ms"));
+  out_crlf();
+}
@@ -0,0 +1,38 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+
+// Traffic and error counters. Everything here is only touched from the main
+// loop; the two the softuart ISR bumps are kept separately below.
+struct stats {
+  uint32_t rx_chars;      // frames received off the loop
+  uint32_t tx_chars;      // frames sent to the loop, shifts included
+  uint16_t shifts;        // LTRS/FIGS inserted by the translator
+  uint16_t dropped;       // host chars with no Baudot equivalent
+  uint16_t resyncs;       // times the send shift was forgotten, see shift.c
+  uint16_t heard_shifts;  // shifts typed on a half duplex loop that changed it
+  uint32_t echoes;        // our own frames heard back and dropped (dropecho)
+  uint16_t profiles;      // translation profile switches, see profile.c
+  uint16_t scheduled;     // messages printed by sched.c
+  uint16_t breaks;        // breaks seen on the loop
+  uint16_t outages;       // times the loop went down, see spool.c
+  uint16_t spool_peak;    // most host chars held at once
+  uint16_t spool_lost;    // host chars that didn't fit
+  uint32_t usb_out_bytes; // from the host, see stats.c for why not packets
+  uint32_t usb_in_bytes;  // to the host
+  uint16_t usb_in_stalls; // IN writes that failed or timed out
+  uint16_t max_latency;   // ms a host byte waited before we took it
+};
+
+extern struct stats stats;
+extern volatile uint16_t stats_framing_errors; // stop bit was a space
+extern volatile uint16_t stats_rx_overruns;    // softuart inbuf was full
+extern volatile uint16_t stats_collisions; // half duplex echo lost or garbled
+
+void stats_host_pending(void);
+void stats_host_taken(void);
+void stats_reset(void);
+void stats_print(void);
+
+#endif
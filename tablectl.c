@@ -0,0 +1,291 @@
+/* Host side tool for loading translation tables into the adapter, and
+ * reading them back, a whole table at a time ("tput" and "tget", see
+ * cmdline.c). It goes in through the +++ escape, so the adapter stays in
+ * adapter mode and keeps the rest of its settings.
+ *
+ *   gcc -o tablectl tablectl.c
+ *   ./tablectl -d /dev/ttyACM0 get 6 > ita2.tbl    (the first flash table)
+ *   ./tablectl -d /dev/ttyACM0 put 1 mine.tbl
+ *   for d in /dev/ttyACM*; do ./tablectl -d $d put 1 mine.tbl; done
+ *
+ * Table files are the text the adapter sends: lines of ':', the offset and
+ * up to 32 bytes in hex, then '.' and the CRC-16 of the whole table. The
+ * CRC line can be left out of a file written by hand, it's worked out
+ * before sending; if it's there it has to match. Lines starting with '#'
+ * are comments. "tablectl check FILE" just reads a file and says if it
+ * parses. The adapter checks the table itself before writing it, and says
+ * why if it won't.
+ *
+ * -g sets the escape guard time in ms if it's not the default 1000 ("guard"
+ * on the adapter). */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STX 0x02
+#define ETX 0x03
+#define TABLE_MAX 128
+#define TABLE_LINE 32
+#define REPLY_MAX 4096
+
+static int fd = -1;
+static int guard = 1000;
+
+static void msleep(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+// same as the firmware's _crc_ccitt_update() from 0xFFFF
+static uint16_t crc_ccitt(const uint8_t *t, int n) {
+  uint16_t crc = 0xFFFF;
+  int i;
+
+  while (n--) {
+    crc ^= *t++ << 8;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static int open_port(const char *dev) {
+  struct termios tio;
+
+  fd = open(dev, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+    return -1;
+  }
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B9600); // CDC doesn't care
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  tcflush(fd, TCIOFLUSH);
+  return 0;
+}
+
+static void send_str(const char *s) {
+  size_t n = strlen(s);
+
+  if (write(fd, s, n) != (ssize_t)n)
+    fprintf(stderr, "write: %s\n", strerror(errno));
+}
+
+// Read what the adapter sends inside STX ... ETX into buf, dropping
+// whatever came off the loop outside the frame. Stops early, returning 1,
+// once buf contains until (if not NULL). Returns 0 at ETX, -1 on timeout.
+static int read_frame(char *buf, int max, const char *until, int timeout_ms) {
+  struct pollfd p = {fd, POLLIN, 0};
+  static int in_frame = 0;
+  int n = 0;
+  char c;
+
+  buf[0] = 0;
+  for (;;) {
+    if (poll(&p, 1, timeout_ms) <= 0)
+      return -1;
+    if (read(fd, &c, 1) != 1)
+      return -1;
+    if (c == STX) {
+      in_frame = 1;
+      continue;
+    }
+    if (!in_frame)
+      continue;
+    if (c == ETX) {
+      in_frame = 0;
+      return 0;
+    }
+    if (n < max - 1) {
+      buf[n++] = c;
+      buf[n] = 0;
+    }
+    if (until && strstr(buf, until))
+      return 1;
+  }
+}
+
+// +++ with the guard time either side, then the command. Returns 0 once the
+// adapter is running it.
+static int command(const char *cmd) {
+  char buf[REPLY_MAX];
+
+  msleep(guard + 100);
+  send_str("+++");
+  msleep(guard + 100);
+  if (read_frame(buf, sizeof(buf), NULL, 2000) < 0) {
+    fprintf(stderr, "no prompt after +++, is the escape on?\n");
+    return -1;
+  }
+  send_str(cmd);
+  send_str("\r"); // not CR LF, the LF would go to the loop
+  return 0;
+}
+
+// Parse a table from f (name is for messages). Returns its size, or -1.
+static int parse_table(FILE *f, const char *name, uint8_t *t) {
+  char line[256];
+  int len = 0, lineno = 0, crc = -1;
+  unsigned off, b, c;
+  char *s;
+
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    line[strcspn(line, "\r\n")] = 0;
+    if ((line[0] == 0) || (line[0] == '#'))
+      continue;
+    if ((line[0] == '.') && (sscanf(line + 1, "%4x", &c) == 1)) {
+      crc = c;
+      break;
+    }
+    if ((line[0] != ':') || (sscanf(line + 1, "%2x", &off) != 1) ||
+        ((int)off != len)) {
+      fprintf(stderr, "%s:%d: expected :%02X...\n", name, lineno, len);
+      return -1;
+    }
+    for (s = line + 3; *s; s += 2) {
+      if ((len >= TABLE_MAX) || (sscanf(s, "%2x", &b) != 1) || !s[1]) {
+        fprintf(stderr, "%s:%d: bad data\n", name, lineno);
+        return -1;
+      }
+      t[len++] = b;
+    }
+  }
+  if ((len != 64) && (len != 128)) {
+    fprintf(stderr, "%s: %d bytes, a table is 64 or 128\n", name, len);
+    return -1;
+  }
+  if ((crc >= 0) && (crc != crc_ccitt(t, len))) {
+    fprintf(stderr, "%s: CRC %04X, the data has %04X\n", name, crc,
+            crc_ccitt(t, len));
+    return -1;
+  }
+  return len;
+}
+
+static int read_table(const char *path, uint8_t *t) {
+  FILE *f = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+  int len;
+
+  if (!f) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  len = parse_table(f, path, t);
+  if (f != stdin)
+    fclose(f);
+  return len;
+}
+
+static int table_get(int n) {
+  char buf[REPLY_MAX], cmd[16];
+  uint8_t t[TABLE_MAX];
+  FILE *f;
+  int len;
+
+  snprintf(cmd, sizeof(cmd), "tget %d", n);
+  if (command(cmd) < 0)
+    return 1;
+  if (read_frame(buf, sizeof(buf), NULL, 3000) < 0) {
+    fprintf(stderr, "no answer\n");
+    return 1;
+  }
+  // check it the same way put would before keeping it
+  f = fmemopen(buf, strlen(buf), "r");
+  len = f ? parse_table(f, "reply", t) : -1;
+  if (f)
+    fclose(f);
+  if (len < 0) {
+    fputs(buf, stderr);
+    return 1;
+  }
+  fputs(buf + strspn(buf, "\r\n"), stdout);
+  return 0;
+}
+
+static int table_put(int n, const char *path) {
+  char buf[REPLY_MAX], cmd[16], line[8 + 2 * TABLE_LINE];
+  uint8_t t[TABLE_MAX];
+  int len, i, j;
+
+  if ((len = read_table(path, t)) < 0)
+    return 1;
+  snprintf(cmd, sizeof(cmd), "tput %d", n);
+  if (command(cmd) < 0)
+    return 1;
+  if (read_frame(buf, sizeof(buf), "Send table", 3000) != 1) {
+    fprintf(stderr, "%s", buf);
+    return 1;
+  }
+  for (i = 0; i < len; i += TABLE_LINE) {
+    snprintf(line, sizeof(line), ":%02X", i);
+    for (j = i; (j < len) && (j < i + TABLE_LINE); j++)
+      snprintf(line + strlen(line), 3, "%02X", t[j]);
+    strcat(line, "\r");
+    send_str(line);
+  }
+  snprintf(line, sizeof(line), ".%04X\r", crc_ccitt(t, len));
+  send_str(line);
+  if (read_frame(buf, sizeof(buf), NULL, 3000) < 0) {
+    fprintf(stderr, "no answer\n");
+    return 1;
+  }
+  fputs(buf + strspn(buf, "\r\n"), stderr);
+  return strstr(buf, "written") ? 0 : 1;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: tablectl [-d DEV] [-g GUARD_MS] get N\n"
+                  "       tablectl [-d DEV] [-g GUARD_MS] put N FILE\n"
+                  "       tablectl check FILE\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *dev = "/dev/ttyACM0";
+  uint8_t t[TABLE_MAX];
+  int opt, len;
+
+  while ((opt = getopt(argc, argv, "d:g:")) != -1) {
+    switch (opt) {
+    case 'd':
+      dev = optarg;
+      break;
+    case 'g':
+      guard = atoi(optarg);
+      break;
+    default:
+      usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc < 2)
+    usage();
+
+  if (strcmp(argv[0], "check") == 0) {
+    if ((len = read_table(argv[1], t)) < 0)
+      return 1;
+    printf("%d bytes, first byte %d, CRC %04X\n", len, t[0],
+           crc_ccitt(t, len));
+    return 0;
+  }
+  if (open_port(dev) < 0)
+    return 1;
+  if (strcmp(argv[0], "get") == 0)
+    return table_get(atoi(argv[1]));
+  if ((strcmp(argv[0], "put") == 0) && (argc == 3))
+    return table_put(atoi(argv[1]), argv[2]);
+  usage();
+  return 2;
+}
@@ -0,0 +1,40 @@
+/* 1ms system tick on Timer0. Timer1 belongs to the softuart and runs at 3x
+ * the loop baud rate, which is too coarse and changes with "baud".
+ *
+ * Besides counting, the tick is what wakes main() from idle_sleep() to poll
+ * USB: LUFA runs polled here, with no endpoint or SOF interrupts, so this
+ * interrupt fires 1000 times a second even with the loop and host idle. */
+
+#include "tick.h"
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+static volatile uint32_t tick_count = 0;
+
+ISR(TIMER0_COMPA_vect) { tick_count++; }
+
+void tick_init(void) {
+  TCCR0A = _BV(WGM01);             // CTC mode
+  OCR0A = (F_CPU / 64 / 1000) - 1; // 250 counts = 1ms at 16MHz
+  TCNT0 = 0;
+  tick_start();
+}
+
+// Stopped while USB is suspended, so only USB wakeup (or the loop) wakes
+// main(). millis() stands still in between.
+void tick_stop(void) {
+  TIMSK0 &= ~_BV(OCIE0A);
+  TCCR0B = 0;
+}
+
+void tick_start(void) {
+  TCCR0B = _BV(CS01) | _BV(CS00); // clk/64
+  TIMSK0 |= _BV(OCIE0A);
+}
+
+uint32_t millis(void) {
+  uint32_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { t = tick_count; }
+  return t;
+}
@@ -0,0 +1,13 @@
+#ifndef _TICK_H_
+#define _TICK_H_
+
+#include <stdint.h>
+
+// Free running millisecond clock on Timer0, independent of the softuart
+// baud timer.
+void tick_init(void);
+void tick_stop(void);
+void tick_start(void);
+uint32_t millis(void);
+
+#endif
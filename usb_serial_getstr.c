@@ -1,4 +1,5 @@
 #include "lufa_serial.h"
+#include "out.h"
 #include <stdint.h>
 
 char usb_serial_getchar(void);
@@ -7,7 +8,7 @@ void usb_serial_putchar(char);
 extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface;
 
 void usb_serial_putchar(char c) {
-  CDC_Device_SendByte(&VirtualSerial_CDC_Interface, (uint8_t)c);
+  out_char(c);
   CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
   USB_USBTask();
   // _delay_us(50);
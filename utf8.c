@@ -0,0 +1,144 @@
+/* UTF-8 in translate mode.
+ *
+ * With the utf8 flag, bytes from the host are decoded as they come, one at a
+ * time: plain ASCII goes straight on, and a multi-byte sequence is held
+ * until it's complete, then looked up. utf8_map has the odd ones out
+ * (quotes, dashes, "EUR"); accented Latin letters fold to the bare letter.
+ * What it comes out as is queued here and handed to the loop one char at a
+ * time by main(), as the TX queue has room. Anything not in the tables, and
+ * broken sequences, count as dropped like any other char with no Baudot.
+ *
+ * With utf8out, the received control codes in utf8_sym go to the host as a
+ * UTF-8 symbol instead: the bell, and WRU (ENQ in the default table). */
+
+#include "utf8.h"
+#include "stats.h"
+#include "usb_serial_getstr.h"
+#include <avr/pgmspace.h>
+
+struct utf8_map {
+  uint16_t cp;
+  char s[UTF8_MAXOUT]; // not terminated when full, empty means just drop it
+};
+
+// sorted by code point
+static const struct utf8_map utf8_map[] PROGMEM = {
+    {0x00A0, " "},   {0x00A1, "!"},   {0x00A2, "C"},   {0x00A3, "GBP"},
+    {0x00A5, "YEN"}, {0x00A9, "(C)"}, {0x00AB, "\""},  {0x00AD, ""},
+    {0x00B0, "DEG"}, {0x00B1, "+-"},  {0x00B7, "."},   {0x00BB, "\""},
+    {0x00BC, "1/4"}, {0x00BD, "1/2"}, {0x00BE, "3/4"}, {0x00BF, "?"},
+    {0x00C6, "AE"},  {0x00DE, "TH"},  {0x00DF, "SS"},  {0x00E6, "AE"},
+    {0x00FE, "TH"},  {0x0132, "IJ"},  {0x0133, "IJ"},  {0x0152, "OE"},
+    {0x0153, "OE"},  {0x200B, ""},    {0x2010, "-"},   {0x2011, "-"},
+    {0x2012, "-"},   {0x2013, "-"},   {0x2014, "-"},   {0x2015, "-"},
+    {0x2018, "'"},   {0x2019, "'"},   {0x201A, "'"},   {0x201B, "'"},
+    {0x201C, "\""},  {0x201D, "\""},  {0x201E, "\""},  {0x201F, "\""},
+    {0x2022, "-"},   {0x2026, "..."}, {0x2032, "'"},   {0x2033, "\""},
+    {0x2039, "'"},   {0x203A, "'"},   {0x2044, "/"},   {0x20AC, "EUR"},
+    {0x2122, "TM"},  {0x2212, "-"},   {0xFEFF, ""},
+};
+#define UTF8_NMAP (sizeof(utf8_map) / sizeof(utf8_map[0]))
+
+// U+00C0 to U+017F, one letter each
+#define UTF8_FOLD_START 0x00C0
+static const char utf8_fold[] PROGMEM =
+    "AAAAAAACEEEEIIIIDNOOOOOXOUUUUYTS"  // U+00C0
+    "AAAAAAACEEEEIIIIDNOOOOO/OUUUUYTY"  // U+00E0
+    "AAAAAACCCCCCCCDDDDEEEEEEEEEEGGGG"  // U+0100
+    "GGGGHHHHIIIIIIIIIIIIJJKKKLLLLLLL"  // U+0120
+    "LLLNNNNNNNNNOOOOOOOORRRRRRSSSSSS"  // U+0140
+    "SSTTTTTTUUUUUUUUUUUUWWYYYZZZZZZS"; // U+0160
+#define UTF8_FOLD_END (UTF8_FOLD_START + sizeof(utf8_fold) - 1)
+
+struct utf8_sym {
+  char c;
+  char s[4];
+};
+
+static const struct utf8_sym utf8_sym[] PROGMEM = {
+    {0x05, "\xE2\x90\x85"},     // WRU, U+2405 symbol for enquiry
+    {0x07, "\xF0\x9F\x94\x94"}, // bell, U+1F514
+};
+#define UTF8_NSYM (sizeof(utf8_sym) / sizeof(utf8_sym[0]))
+
+static uint32_t cp;       // code point so far
+static uint8_t more = 0;  // continuation bytes still to come
+static const char *out;   // what it came out as, in flash
+static uint8_t out_n = 0; // and how much of that is left
+
+static void utf8_lookup(void) {
+  uint8_t i;
+
+  for (i = 0; i < UTF8_NMAP; i++)
+    if (pgm_read_word(&utf8_map[i].cp) == cp) {
+      out = utf8_map[i].s;
+      for (out_n = 0; out_n < UTF8_MAXOUT; out_n++)
+        if (!pgm_read_byte(out + out_n))
+          break;
+      return;
+    }
+  if ((cp >= UTF8_FOLD_START) && (cp < UTF8_FOLD_END)) {
+    out = utf8_fold + (cp - UTF8_FOLD_START);
+    out_n = 1;
+    return;
+  }
+  stats.dropped++;
+}
+
+// Called with every char from the host in translate mode. Returns TRUE if
+// it was part of a multi-byte sequence, so it must not go to the loop as
+// it is.
+uint8_t utf8_take(char c) {
+  uint8_t b = c;
+
+  if (more) {
+    if ((b & 0xC0) == 0x80) {
+      cp = (cp << 6) | (b & 0x3F);
+      if (--more == 0)
+        utf8_lookup();
+      return 1;
+    }
+    more = 0; // cut short, this starts something new
+    stats.dropped++;
+  }
+  if (b < 0x80)
+    return 0;
+  if ((b & 0xE0) == 0xC0) {
+    cp = b & 0x1F;
+    more = 1;
+  } else if ((b & 0xF0) == 0xE0) {
+    cp = b & 0x0F;
+    more = 2;
+  } else if ((b & 0xF8) == 0xF0) {
+    cp = b & 0x07;
+    more = 3;
+  } else // a stray continuation byte, or not UTF-8 at all
+    stats.dropped++;
+  return 1;
+}
+
+// chars of the last sequence not yet taken with utf8_next()
+uint8_t utf8_pending(void) { return out_n; }
+
+char utf8_next(void) {
+  if (!out_n)
+    return 0;
+  out_n--;
+  return pgm_read_byte(out++);
+}
+
+// a received char on its way to the host, through put()
+void utf8_to_host(char c, void (*put)(char)) {
+  uint8_t i;
+  const char *s;
+  char b;
+
+  for (i = 0; i < UTF8_NSYM; i++)
+    if (pgm_read_byte(&utf8_sym[i].c) == c) {
+      s = utf8_sym[i].s;
+      while ((b = pgm_read_byte(s++)))
+        put(b);
+      return;
+    }
+  put(c);
+}
@@ -0,0 +1,9 @@
+// UTF-8 from the host, transliterated to what the machine can print, and a
+// few received control codes sent back as UTF-8 symbols. See utf8.c.
+
+#define UTF8_MAXOUT 3 // longest transliteration, "EUR"
+
+uint8_t utf8_take(char c);
+uint8_t utf8_pending(void);
+char utf8_next(void);
+void utf8_to_host(char c, void (*put)(char));